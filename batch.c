@@ -0,0 +1,276 @@
+/*
+    This file includes the batch mode, which converts many PPM files in one process.
+    One plan (and hash table) is shared by all files and every thread of the pool reads, converts and writes whole files,
+    so reading one file overlaps with computing and writing the others.
+    With --incremental the files are frames of one sequence, they are converted in order and
+    the threads share the tiles of every frame (gamma_correct_tiles).
+    Header file batch.h defines the batch function.
+*/
+
+#include "batch.h"
+#include "image_library.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Everything the threads share while working on one batch
+typedef struct batchJob {
+  char** inputNames;
+  char* outputDirectory;
+  gammaPlan* plan;
+  tileCache* tiles; // NULL = every file on its own
+  threadPool* pool;
+  int failedFiles;
+  size_t bytes; // input and output bytes of all converted files
+} batchJob;
+
+// Returns true if name ends with ".ppm"
+static int isPPMName(char* name) {
+    size_t length = strlen(name);
+    return length > 4 && strcmp(name + length - 4, ".ppm") == 0;
+}
+
+// Adds a copy of name to the growing list names
+static int appendName(char*** names, int* count, int* capacity, char* name) {
+    if(*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        char** grown = realloc(*names, *capacity * sizeof(char*));
+        if(!grown)
+            return EXIT_FAILURE;
+        *names = grown;
+    }
+    (*names)[*count] = strdup(name);
+    if(!(*names)[*count])
+        return EXIT_FAILURE;
+    (*count)++;
+    return EXIT_SUCCESS;
+}
+
+static int compareNames(const void* first, const void* second) {
+    return strcmp(*(char**)first, *(char**)second);
+}
+
+// Returns the name of the output file of inputName without directory and .ppm, length is set to its length
+static char* getOutputBaseName(char* inputName, int* length) {
+    char* baseName = strrchr(inputName, '/');
+    baseName = baseName ? baseName + 1 : inputName;
+    *length = strlen(baseName);
+    if(isPPMName(baseName))
+        *length -= 4;
+    return baseName;
+}
+
+static int compareOutputBaseNames(const void* first, const void* second) {
+    int firstLength;
+    int secondLength;
+    char* firstName = getOutputBaseName(*(char**)first, &firstLength);
+    char* secondName = getOutputBaseName(*(char**)second, &secondLength);
+    int order = memcmp(firstName, secondName, firstLength < secondLength ? firstLength : secondLength);
+    return order != 0 ? order : firstLength - secondLength;
+}
+
+// Fails if two input files would write the same output file (a/x.ppm and b/x.ppm both write x.pgm),
+// the threads would write it at the same time
+static int checkOutputNames(char** names, int count, char* outputDirectory) {
+    char** sorted = malloc(count * sizeof(char*));
+    int result = EXIT_SUCCESS;
+
+    if(!sorted) {
+        fprintf(stderr, "gamma_correct_batch: Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+    memcpy(sorted, names, count * sizeof(char*));
+    qsort(sorted, count, sizeof(char*), compareOutputBaseNames);
+    for(int i = 1; i < count; i++) {
+        if(compareOutputBaseNames(&sorted[i - 1], &sorted[i]) == 0) {
+            int length;
+            char* baseName = getOutputBaseName(sorted[i], &length);
+            fprintf(stderr, "gamma_correct_batch: %s and %s both write %s/%.*s.pgm\n",
+                sorted[i - 1], sorted[i], outputDirectory, length, baseName);
+            result = EXIT_FAILURE;
+        }
+    }
+    free(sorted);
+    return result;
+}
+
+// Collects the input files: all .ppm files of a directory or one path per line of a list file
+static int collectInputNames(char* inputList, char*** names, int* count) {
+    struct stat listStats;
+    int capacity = 0;
+    char path[4096];
+
+    if(stat(inputList, &listStats) == -1) {
+        fprintf(stderr, "gamma_correct_batch: Could not open %s\n", inputList);
+        return EXIT_FAILURE;
+    }
+
+    if(S_ISDIR(listStats.st_mode)) {
+        DIR* directory = opendir(inputList);
+        if(!directory) {
+            fprintf(stderr, "gamma_correct_batch: Could not open %s\n", inputList);
+            return EXIT_FAILURE;
+        }
+        struct dirent* entry;
+        while((entry = readdir(directory)) != NULL) {
+            if(!isPPMName(entry->d_name))
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", inputList, entry->d_name);
+            if(appendName(names, count, &capacity, path)) {
+                closedir(directory);
+                fprintf(stderr, "gamma_correct_batch: Malloc failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+        closedir(directory);
+        // same order on every run
+        qsort(*names, *count, sizeof(char*), compareNames);
+    } else {
+        FILE* list = fopen(inputList, "r");
+        if(!list) {
+            fprintf(stderr, "gamma_correct_batch: Could not open %s\n", inputList);
+            return EXIT_FAILURE;
+        }
+        while(fgets(path, sizeof(path), list)) {
+            path[strcspn(path, "\r\n")] = '\0';
+            if(path[0] == '\0')
+                continue;
+            if(appendName(names, count, &capacity, path)) {
+                fclose(list);
+                fprintf(stderr, "gamma_correct_batch: Malloc failed\n");
+                return EXIT_FAILURE;
+            }
+        }
+        fclose(list);
+    }
+    return EXIT_SUCCESS;
+}
+
+// Reads, converts and writes file "index" of the batch
+static void convertFile(void* args, int index) {
+    batchJob* job = args;
+    char* inputName = job->inputNames[index];
+    char outputName[4096];
+
+    // outputDirectory/<input name without directory and .ppm>.pgm
+    int baseLength;
+    char* baseName = getOutputBaseName(inputName, &baseLength);
+    snprintf(outputName, sizeof(outputName), "%s/%.*s.pgm", job->outputDirectory, baseLength, baseName);
+
+    imageFile input = {0};
+    imageFile output = {0};
+    if(readPPMImage(&input, inputName) != 0) {
+        fprintf(stderr, "gamma_correct_batch: Skipping %s\n", inputName);
+        __atomic_fetch_add(&job->failedFiles, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    output.width = input.width;
+    output.heigth = input.heigth;
+    if(mapPGMImage(&output, outputName) != 0) {
+        fprintf(stderr, "gamma_correct_batch: Skipping %s\n", inputName);
+        __atomic_fetch_add(&job->failedFiles, 1, __ATOMIC_RELAXED);
+        freeImageFile(&input);
+        return;
+    }
+
+    if(job->tiles != NULL) {
+        size_t dirtyTiles;
+        if(gamma_correct_tiles(job->tiles, job->plan, job->pool, input.content, input.width, input.heigth,
+            output.content, &dirtyTiles) != EXIT_SUCCESS) {
+            fprintf(stderr, "gamma_correct_batch: Skipping %s\n", inputName);
+            __atomic_fetch_add(&job->failedFiles, 1, __ATOMIC_RELAXED);
+            freeImageFile(&input);
+            freeImageFile(&output);
+            return;
+        }
+        printf("gamma_correct_batch: %s: %zu of %zu tiles reprocessed\n", inputName, dirtyTiles,
+            getTileCount(input.width, input.heigth));
+    } else {
+        uint64_t start = traceNow();
+        // both mappings are padded, the kernel runs whole vectors to the end
+        executeGammaPlanPadded(job->plan, input.content, (size_t)input.width * input.heigth, output.content);
+        traceRecord("kernel", start);
+    }
+
+    if(syncPGMImage(&output) != EXIT_SUCCESS) {
+        fprintf(stderr, "gamma_correct_batch: Could not write %s\n", outputName);
+        __atomic_fetch_add(&job->failedFiles, 1, __ATOMIC_RELAXED);
+        freeImageFile(&input);
+        freeImageFile(&output);
+        return;
+    }
+    __atomic_fetch_add(&job->bytes, input.mappingSize - input.padding + output.mappingSize - output.padding,
+        __ATOMIC_RELAXED);
+    freeImageFile(&input);
+    freeImageFile(&output);
+}
+
+// Converts all files of inputList (directory or list file) into outputDirectory
+// With tiles the files are converted one after the other and only their tiles that differ
+// from the file before run through the plan.
+// Prints files/sec and MB/sec (input + output bytes) at the end
+int gamma_correct_batch(char* inputList, char* outputDirectory, gammaPlan* plan, threadPool* pool,
+    tileCache* tiles) {
+        struct stat outputStats;
+        char** inputNames = NULL;
+        int fileCount = 0;
+
+        if(stat(outputDirectory, &outputStats) == -1 || !S_ISDIR(outputStats.st_mode)) {
+            fprintf(stderr, "gamma_correct_batch: Output %s is not a directory\n", outputDirectory);
+            return EXIT_FAILURE;
+        }
+        if(collectInputNames(inputList, &inputNames, &fileCount) != EXIT_SUCCESS) {
+            for(int i = 0; i < fileCount; i++)
+                free(inputNames[i]);
+            free(inputNames);
+            return EXIT_FAILURE;
+        }
+        if(fileCount == 0) {
+            fprintf(stderr, "gamma_correct_batch: No input files in %s\n", inputList);
+            free(inputNames);
+            return EXIT_FAILURE;
+        }
+        if(checkOutputNames(inputNames, fileCount, outputDirectory) != EXIT_SUCCESS) {
+            for(int i = 0; i < fileCount; i++)
+                free(inputNames[i]);
+            free(inputNames);
+            return EXIT_FAILURE;
+        }
+
+        batchJob job = {
+            .inputNames = inputNames, .outputDirectory = outputDirectory, .plan = plan,
+            .tiles = tiles, .pool = pool
+        };
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if(tiles != NULL) {
+            for(int i = 0; i < fileCount; i++)
+                convertFile(&job, i);
+        } else {
+            runThreadPool(pool, convertFile, &job, fileCount);
+        }
+
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+        int convertedFiles = fileCount - job.failedFiles;
+        printf("gamma_correct_batch: Converted %d of %d files on %d threads in %f seconds\n",
+            convertedFiles, fileCount, pool->threadCount, time);
+        printf("gamma_correct_batch: %.1f files/sec, %.1f MB/sec\n",
+            convertedFiles / time, job.bytes / time / (1024 * 1024));
+        if(tiles != NULL && tiles->tiles > 0)
+            printf("gamma_correct_batch: Reprocessed %zu of %zu tiles (%.1f%%)\n",
+                tiles->dirtyTiles, tiles->tiles, 100.0 * tiles->dirtyTiles / tiles->tiles);
+
+        for(int i = 0; i < fileCount; i++)
+            free(inputNames[i]);
+        free(inputNames);
+        return job.failedFiles == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
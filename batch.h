@@ -0,0 +1,12 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "gamma_correct.h"
+#include "parallel.h"
+#include "plan.h"
+#include "tiles.h"
+
+int gamma_correct_batch(char* inputList, char* outputDirectory, gammaPlan* plan, threadPool* pool,
+    tileCache* tiles);
+
+#endif
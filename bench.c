@@ -0,0 +1,313 @@
+/*
+    This file includes the benchmark mode, which compares implementations on several image sizes.
+    Every implementation runs BENCH_WARMUP times unmeasured and then is timed sample by sample,
+    optionally with hardware counters around all samples (only the calling thread is counted,
+    so main does not allow them with -j). The results are printed as a table and can be written as JSON.
+    Header file bench.h defines the result struct and the benchmark function.
+*/
+
+#include "bench.h"
+#include "kernels.h"
+#include "plan.h"
+#include "image_library.h"
+#include "rgb_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <x86intrin.h>
+
+// Image sizes used without an input file and --size: fits in L1, L2, the last level cache and only in DRAM
+static const size_t benchSizes[][2] = {
+    {64, 32}, {256, 256}, {1024, 1024}, {3840, 2160}
+};
+static const int benchSizeCount = sizeof(benchSizes) / sizeof(benchSizes[0]);
+
+static int compareDoubles(const void* first, const void* second) {
+    double difference = *(double*)first - *(double*)second;
+    return (difference > 0) - (difference < 0);
+}
+
+// Value at percentile (0 - 100) of sorted values, nearest rank
+static double percentile(double* sorted, int count, double percent) {
+    int rank = ceil(percent / 100.0 * count);
+    if(rank < 1)
+        rank = 1;
+    return sorted[rank - 1];
+}
+
+// Runs the plan once on the whole image, in bands on the pool if there is one
+// Both images are padded, so like main the kernel runs whole vectors to the end
+static void runOnce(gammaPlan* plan, threadPool* pool, imageFile* input, imageFile* output) {
+    int padded = input->padding >= IMAGE_PADDING && output->padding >= IMAGE_PADDING;
+    if(pool != NULL)
+        gamma_correct_parallel(pool, plan, input->content, input->width, input->heigth, 
+            output->content, padded);
+    else if(padded)
+        executeGammaPlanPadded(plan, input->content, (size_t)input->width * input->heigth, output->content);
+    else
+        executeGammaPlan(plan, input->content, input->width, input->heigth, output->content);
+}
+
+// Measures one implementation on one image, the hash table is built before the first sample
+// counters is NULL if no hardware counters are read, rgbCache is NULL to compute every pixel
+// streaming is the gammaPlan.streaming setting (0 / 1 compare the regular and the streaming version)
+static int benchKernel(int implementation, threadPool* pool, int samples, imageFile* input,
+    imageFile* output, float a, float b, float c, float gamma, perfCounters* counters,
+    char* rgbCache, int streaming, benchResult* result) {
+        double* times = malloc(samples * sizeof(double));
+        double* cycles = malloc(samples * sizeof(double));
+        if(!times || !cycles) {
+            fprintf(stderr, "gamma_correct_bench: Malloc failed\n");
+            free(times);
+            free(cycles);
+            return EXIT_FAILURE;
+        }
+
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[implementation], a, b, c, gamma);
+        plan.streaming = streaming;
+        if(rgbCache != NULL && attachRGBTable(&plan, rgbCache, pool) != EXIT_SUCCESS) {
+            free(times);
+            free(cycles);
+            return EXIT_FAILURE;
+        }
+
+        for(int i = 0; i < BENCH_WARMUP; i++)
+            runOnce(&plan, pool, input, output);
+
+        if(counters != NULL)
+            startPerfCounters(counters);
+        for(int i = 0; i < samples; i++) {
+            struct timespec start;
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            uint64_t startCycles = __rdtsc();
+
+            runOnce(&plan, pool, input, output);
+
+            uint64_t endCycles = __rdtsc();
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            times[i] = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+            cycles[i] = endCycles - startCycles;
+        }
+        for(int i = 0; i < PERF_COUNTER_COUNT; i++)
+            result->counters[i] = -1;
+        if(counters != NULL) {
+            stopPerfCounters(counters);
+            for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+                if(counters->values[i] >= 0)
+                    result->counters[i] = counters->values[i] / samples;
+            }
+        }
+
+        double sum = 0.0;
+        double squares = 0.0;
+        for(int i = 0; i < samples; i++)
+            sum += times[i];
+        double mean = sum / samples;
+        for(int i = 0; i < samples; i++)
+            squares += (times[i] - mean) * (times[i] - mean);
+
+        qsort(times, samples, sizeof(double), compareDoubles);
+        qsort(cycles, samples, sizeof(double), compareDoubles);
+
+        double pixels = (double)input->width * input->heigth;
+        result->implementation = implementation;
+        result->rgbTable = rgbCache != NULL;
+        result->streaming = usesStreamingKernel(&plan, (size_t)pixels);
+        result->width = input->width;
+        result->height = input->heigth;
+        result->samples = samples;
+        result->median = percentile(times, samples, 50);
+        result->p5 = percentile(times, samples, 5);
+        result->p95 = percentile(times, samples, 95);
+        result->mean = mean;
+        result->stddev = samples > 1 ? sqrt(squares / (samples - 1)) : 0.0;
+        result->megapixelsPerSecond = pixels / result->median / 1e6;
+        result->gigabytesPerSecond = pixels * 4 / result->median / 1e9;
+        // counters are per run, so the misses go with the mean time (the median drops the slow samples)
+        result->dramMeasured = result->counters[PERF_LLC_MISSES] >= 0;
+        if(result->dramMeasured)
+            result->dramGigabytesPerSecond = result->counters[PERF_LLC_MISSES] * 64 / mean / 1e9;
+        else
+            result->dramGigabytesPerSecond = pixels * (result->streaming ? 4 : 5) / result->median / 1e9;
+        result->cyclesPerPixel = percentile(cycles, samples, 50) / pixels;
+
+        releaseRGBTable(&plan);
+        free(times);
+        free(cycles);
+        return EXIT_SUCCESS;
+}
+
+static void printResult(benchResult* result, int perf) {
+    char name[64];
+    snprintf(name, sizeof(name), "%s%s%s", kernelRegistry[result->implementation].name,
+        result->rgbTable ? " +rgb" : "", result->streaming ? " +nt" : "");
+    // "~" marks an estimated DRAM GB/s
+    printf("%-36s %5zux%-5zu %10.3f %10.3f %10.3f %9.3f %9.1f %7.2f %8.2f%c %7.2f\n",
+        name, result->width, result->height,
+        result->median * 1e3, result->p5 * 1e3, result->p95 * 1e3, result->stddev * 1e3,
+        result->megapixelsPerSecond, result->gigabytesPerSecond, result->dramGigabytesPerSecond,
+        result->dramMeasured ? ' ' : '~', result->cyclesPerPixel);
+    if(!perf)
+        return;
+
+    // counters per pixel in a second line, "-" for counters that are not available
+    double pixels = (double)result->width * result->height;
+    double* counters = result->counters;
+    printf("    IPC ");
+    if(counters[PERF_CYCLES] > 0 && counters[PERF_INSTRUCTIONS] >= 0)
+        printf("%.2f", counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES]);
+    else
+        printf("-");
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if(counters[i] >= 0)
+            printf("  %s/px %.4g", perfCounterName(i), counters[i] / pixels);
+        else
+            printf("  %s/px -", perfCounterName(i));
+    }
+    printf("\n");
+}
+
+static int writeJSON(char* jsonName, benchResult* results, int resultCount, threadPool* pool,
+    float a, float b, float c, float gamma, char* inputName, imagePattern pattern) {
+        FILE* file = fopen(jsonName, "w");
+        if(!file) {
+            fprintf(stderr, "gamma_correct_bench: Could not open %s\n", jsonName);
+            return EXIT_FAILURE;
+        }
+
+        fprintf(file, "{\n  \"gamma\": %g,\n  \"coeffs\": [%g, %g, %g],\n", gamma, a, b, c);
+        fprintf(file, "  \"input\": \"%s\",\n", inputName != NULL ? inputName : patternName(pattern));
+        fprintf(file, "  \"threads\": %d,\n  \"warmup\": %d,\n  \"results\": [\n",
+            pool != NULL ? pool->threadCount : 0, BENCH_WARMUP);
+        for(int i = 0; i < resultCount; i++) {
+            benchResult* result = &results[i];
+            fprintf(file, "    {\"kernel\": \"%s\", \"index\": %d, \"rgb_table\": %s, \"streaming\": %s, "
+                "\"width\": %zu, \"height\": %zu, "
+                "\"samples\": %d, \"median_s\": %.9f, \"p5_s\": %.9f, \"p95_s\": %.9f, "
+                "\"mean_s\": %.9f, \"stddev_s\": %.9f, \"mpixels_per_s\": %.3f, "
+                "\"gb_per_s\": %.3f, \"dram_gb_per_s\": %.3f, \"dram_source\": \"%s\", \"cycles_per_pixel\": %.4f",
+                kernelRegistry[result->implementation].name, result->implementation,
+                result->rgbTable ? "true" : "false", result->streaming ? "true" : "false",
+                result->width, result->height, result->samples, result->median, result->p5,
+                result->p95, result->mean, result->stddev, result->megapixelsPerSecond,
+                result->gigabytesPerSecond, result->dramGigabytesPerSecond,
+                result->dramMeasured ? "llc_misses" : "estimate", result->cyclesPerPixel);
+
+            // counters per run, null if they were not measured or are not available
+            fprintf(file, ", \"counters\": {");
+            for(int k = 0; k < PERF_COUNTER_COUNT; k++) {
+                if(result->counters[k] >= 0)
+                    fprintf(file, "\"%s\": %.1f, ", perfCounterName(k), result->counters[k]);
+                else
+                    fprintf(file, "\"%s\": null, ", perfCounterName(k));
+            }
+            if(result->counters[PERF_CYCLES] > 0 && result->counters[PERF_INSTRUCTIONS] >= 0)
+                fprintf(file, "\"ipc\": %.3f}", result->counters[PERF_INSTRUCTIONS] / result->counters[PERF_CYCLES]);
+            else
+                fprintf(file, "\"ipc\": null}");
+            fprintf(file, "}%s\n", i + 1 < resultCount ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+
+        if(fclose(file) != 0) {
+            fprintf(stderr, "gamma_correct_bench: Could not write %s\n", jsonName);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+}
+
+// Benchmarks one implementation (or all the CPU supports if implementation is -1)
+// on the input file, or if inputName is NULL on generated images (pattern, seed) of width x height
+// or of all benchSizes if width is 0. Writes the results as JSON to jsonName if it is not NULL.
+// perf reads the hardware counters around the samples of every implementation.
+// With rgbCache every implementation runs a second time with its RGB table from that directory.
+// Implementations with a streaming version run with and without it (+nt), whatever the image size.
+int gamma_correct_bench(char* inputName, int implementation, threadPool* pool, int samples,
+    float a, float b, float c, float gamma, char* jsonName,
+    imagePattern pattern, uint32_t seed, size_t width, size_t height, int perf, char* rgbCache) {
+        int sizeCount = inputName != NULL || width > 0 ? 1 : benchSizeCount;
+        int variants = 3; // regular, streaming (only implementations with one), RGB table (with rgbCache)
+        perfCounters counters;
+        benchResult* results = malloc((size_t)sizeCount * kernelCount * variants * sizeof(benchResult));
+        int resultCount = 0;
+        int result = EXIT_SUCCESS;
+
+        if(!results) {
+            fprintf(stderr, "gamma_correct_bench: Malloc failed\n");
+            return EXIT_FAILURE;
+        }
+        if(samples < 1)
+            samples = 1;
+        if(perf)
+            openPerfCounters(&counters);
+
+        printf("%-36s %11s %10s %10s %10s %9s %9s %7s %9s %7s\n", "implementation", "size",
+            "median ms", "p5 ms", "p95 ms", "stddev ms", "Mpixel/s", "GB/s", "DRAM GB/s", "cyc/px");
+
+        for(int s = 0; s < sizeCount && result == EXIT_SUCCESS; s++) {
+            imageFile input = {0};
+            if(inputName != NULL) {
+                if(readPPMImage(&input, inputName) != 0) {
+                    result = EXIT_FAILURE;
+                    break;
+                }
+            } else if(generatePPMImage(&input, width > 0 ? width : benchSizes[s][0],
+                width > 0 ? height : benchSizes[s][1], pattern, seed) != EXIT_SUCCESS) {
+                    result = EXIT_FAILURE;
+                    break;
+            }
+
+            imageFile output = {0};
+            if(allocImageContent(&output, (size_t)input.width * input.heigth) != EXIT_SUCCESS) {
+                freeImageFile(&input);
+                result = EXIT_FAILURE;
+                break;
+            }
+
+            for(int k = 0; k < kernelCount; k++) {
+                if(implementation != -1 && k != implementation)
+                    continue;
+                if(!isKernelSupported(&kernelRegistry[k]))
+                    continue;
+                int hasStreaming = kernelRegistry[k].streamingHashFunction != NULL;
+                for(int v = 0; v < variants && result == EXIT_SUCCESS; v++) {
+                    if((v == 1 && !hasStreaming) || (v == 2 && rgbCache == NULL))
+                        continue;
+                    // implementations with a streaming version run without and with it on every size
+                    int streaming = v == 1 ? 1 : v == 0 && hasStreaming ? 0 : STREAMING_AUTO;
+                    if(benchKernel(k, pool, samples, &input, &output, a, b, c, gamma,
+                        perf ? &counters : NULL, v == 2 ? rgbCache : NULL, streaming,
+                        &results[resultCount]) != EXIT_SUCCESS) {
+                            result = EXIT_FAILURE;
+                            break;
+                    }
+                    printResult(&results[resultCount], perf);
+                    resultCount++;
+                }
+                if(result != EXIT_SUCCESS)
+                    break;
+            }
+
+            freeImageFile(&output);
+            freeImageFile(&input);
+        }
+        for(int i = 0; i < resultCount; i++) {
+            if(!results[i].dramMeasured) {
+                printf("~ DRAM GB/s estimated from the image size (no --perf llc_misses), "
+                    "without the RGB table reads of +rgb\n");
+                break;
+            }
+        }
+
+        if(result == EXIT_SUCCESS && jsonName != NULL)
+            result = writeJSON(jsonName, results, resultCount, pool, a, b, c, gamma,
+                inputName, pattern);
+
+        if(perf)
+            closePerfCounters(&counters);
+        free(results);
+        return result;
+}
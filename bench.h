@@ -0,0 +1,44 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "parallel.h"
+#include "generate.h"
+#include "perf_counters.h"
+
+// Runs before the measured samples to warm up caches, page tables and the CPU frequency
+#define BENCH_WARMUP 3
+// Measured samples per implementation and size if -B is not set
+#define BENCH_SAMPLES 21
+
+// Statistics of the samples of one implementation on one image size
+typedef struct benchResult {
+  int implementation;
+  int rgbTable; // 1 if the implementation ran with its RGB table (--rgb-cache)
+  int streaming; // 1 if the streaming version of the implementation ran (non-temporal stores)
+  size_t width;
+  size_t height;
+  int samples;
+  double median; // seconds
+  double p5;
+  double p95;
+  double mean;
+  double stddev;
+  double megapixelsPerSecond;
+  double gigabytesPerSecond; // 3 input + 1 output bytes per pixel
+  // DRAM traffic: last level cache misses * 64 bytes per second if --perf could read them,
+  // otherwise estimated for an image that is not in cache as gigabytesPerSecond plus the read for ownership
+  // of every output line with regular stores (1 byte per pixel, also with the RGB table, whose reads
+  // are not included), the streaming version has none
+  double dramGigabytesPerSecond;
+  int dramMeasured; // 1 if dramGigabytesPerSecond comes from the llc_misses counter, 0 if it is the estimate
+  double cyclesPerPixel; // TSC cycles of the median sample
+  double counters[PERF_COUNTER_COUNT]; // per run over all samples, -1 if not measured
+} benchResult;
+
+int gamma_correct_bench(char* inputName, int implementation, threadPool* pool, int samples,
+    float a, float b, float c, float gamma, char* jsonName,
+    imagePattern pattern, uint32_t seed, size_t width, size_t height, int perf, char* rgbCache);
+
+#endif
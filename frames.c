@@ -0,0 +1,294 @@
+/*
+    This file includes the frame stream mode, which converts P6 frames that follow each other
+    on a pipe (e.g. from a video decoder) to P5 frames on another pipe.
+    A reader thread parses frame N + 1 while the calling thread computes frame N and a writer thread
+    writes frame N - 1. The plan, the buffers and the threads are reused for all frames.
+    Header file frames.h defines the frame slots.
+*/
+
+#include "frames.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+// State shared by the reader thread, the writer thread and the calling thread (compute)
+// Frame k uses slot k % 2, the semaphores hand the slots from one stage to the next
+typedef struct frameJob {
+  int inputFd;
+  int outputFd;
+  frameSlot slots[2];
+  sem_t inputFree[2];
+  sem_t inputReady[2];
+  sem_t outputFree[2];
+  sem_t outputReady[2];
+  // bytes read from the input but not parsed yet are buffer[bufferStart] to buffer[bufferEnd - 1]
+  uint8_t* buffer;
+  size_t bufferStart;
+  size_t bufferEnd;
+  int endOfInput;
+  size_t framesRead;
+  size_t frames; // frames written so far
+  int readError;
+  int writeError;
+  int stop; // set by the calling thread, the reader reads no more frames
+} frameJob;
+
+// Reads what the input has (at least one byte) after the unparsed bytes, sets endOfInput at its end
+static int fillBuffer(frameJob* job) {
+    if(job->bufferStart > 0) {
+        memmove(job->buffer, job->buffer + job->bufferStart, job->bufferEnd - job->bufferStart);
+        job->bufferEnd -= job->bufferStart;
+        job->bufferStart = 0;
+    }
+
+    ssize_t bytesRead = read(job->inputFd, job->buffer + job->bufferEnd, FRAME_BUFFER_BYTES - job->bufferEnd);
+    if(bytesRead < 0)
+        return EXIT_FAILURE;
+    if(bytesRead == 0)
+        job->endOfInput = 1;
+    job->bufferEnd += bytesRead;
+    return EXIT_SUCCESS;
+}
+
+// Reads exactly size bytes, returns EXIT_FAILURE on errors or the end of the input
+static int readFully(int fd, uint8_t* buffer, size_t size) {
+    while(size > 0) {
+        ssize_t bytesRead = read(fd, buffer, size);
+        if(bytesRead <= 0)
+            return EXIT_FAILURE;
+        buffer += bytesRead;
+        size -= bytesRead;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Writes exactly size bytes, returns EXIT_FAILURE on errors
+static int writeFully(int fd, uint8_t* buffer, size_t size) {
+    while(size > 0) {
+        ssize_t bytesWritten = write(fd, buffer, size);
+        if(bytesWritten <= 0)
+            return EXIT_FAILURE;
+        buffer += bytesWritten;
+        size -= bytesWritten;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Makes image hold at least size bytes, keeps it if it is large enough already
+static int reserveContent(imageFile* image, size_t* capacity, size_t size) {
+    if(size <= *capacity)
+        return EXIT_SUCCESS;
+    freeImageFile(image);
+    *image = (imageFile){0};
+    *capacity = 0;
+    if(allocImageContent(image, size) != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+    *capacity = size;
+    return EXIT_SUCCESS;
+}
+
+// Reads the next frame into slot, returns 1 for a frame, 0 at the end of the input and -1 on errors
+// The header is parsed from the buffer, which is filled until the header is complete
+static int readFrame(frameJob* job, frameSlot* slot) {
+    imageFile header = {0};
+    size_t headerSize = 0;
+
+    while(1) {
+        if(job->bufferStart == job->bufferEnd) {
+            if(job->endOfInput)
+                return 0;
+            if(fillBuffer(job) != EXIT_SUCCESS)
+                return -1;
+            continue;
+        }
+        headerReader reader = {.data = job->buffer + job->bufferStart,
+            .size = job->bufferEnd - job->bufferStart, .partial = !job->endOfInput};
+        if(parsePPMHeader(&header, &reader, &headerSize) == EXIT_SUCCESS)
+            break;
+        if(!reader.truncated || job->endOfInput)
+            return -1;
+        if(job->bufferEnd - job->bufferStart >= MAX_FRAME_HEADER_BYTES) {
+            fprintf(stderr, "gamma_correct_frames: Header longer than %d bytes\n", MAX_FRAME_HEADER_BYTES);
+            return -1;
+        }
+        if(fillBuffer(job) != EXIT_SUCCESS)
+            return -1;
+    }
+    job->bufferStart += headerSize;
+
+    size_t contentSize = (size_t)header.width * header.heigth * 3;
+    if(reserveContent(&slot->input, &slot->inputCapacity, contentSize) != EXIT_SUCCESS)
+        return -1;
+    slot->width = header.width;
+    slot->height = header.heigth;
+
+    // the first pixels may already be in the buffer, the rest goes straight into the frame
+    size_t buffered = job->bufferEnd - job->bufferStart;
+    if(buffered > contentSize)
+        buffered = contentSize;
+    memcpy(slot->input.content, job->buffer + job->bufferStart, buffered);
+    job->bufferStart += buffered;
+    if(readFully(job->inputFd, slot->input.content + buffered, contentSize - buffered) != EXIT_SUCCESS) {
+        fprintf(stderr, "gamma_correct_frames: Frame %zu is shorter than its header\n", job->framesRead + 1);
+        return -1;
+    }
+    job->framesRead++;
+    return 1;
+}
+
+// Reader stage: reads frame k + 1 while frame k is computed
+static void* readerThread(void* args) {
+    frameJob* job = args;
+
+    for(size_t k = 0; ; k++) {
+        int slot = k & 1;
+        sem_wait(&job->inputFree[slot]);
+        if(__atomic_load_n(&job->stop, __ATOMIC_RELAXED))
+            return NULL;
+        uint64_t start = traceNow();
+        int result = readFrame(job, &job->slots[slot]);
+        traceRecord("read", start);
+        job->slots[slot].last = result != 1;
+        if(result == -1)
+            job->readError = 1;
+        sem_post(&job->inputReady[slot]);
+        if(result != 1)
+            return NULL;
+    }
+}
+
+// Writer stage: writes frame k - 1 while frame k is computed
+static void* writerThread(void* args) {
+    frameJob* job = args;
+
+    for(size_t k = 0; ; k++) {
+        int slot = k & 1;
+        frameSlot* frame = &job->slots[slot];
+        sem_wait(&job->outputReady[slot]);
+        if(frame->outputLast)
+            return NULL;
+
+        uint64_t start = traceNow();
+        char header[64];
+        int headerSize = snprintf(header, sizeof(header), "P5\n%u %u\n255\n",
+            frame->outputWidth, frame->outputHeight);
+        // after an error the frames are dropped, the pipeline keeps running to the end of the input
+        if(!job->writeError) {
+            if(writeFully(job->outputFd, (uint8_t*)header, headerSize) == EXIT_SUCCESS
+                && writeFully(job->outputFd, frame->output.content,
+                    (size_t)frame->outputWidth * frame->outputHeight) == EXIT_SUCCESS)
+                job->frames++;
+            else
+                job->writeError = 1;
+        }
+        traceRecord("write", start);
+        sem_post(&job->outputFree[slot]);
+    }
+}
+
+// Converts the P6 frames of inputFd to P5 frames on outputFd with the given plan until the input ends
+// If pool is not NULL every frame is computed with gamma_correct_parallel.
+// With tiles only the tiles that changed since the last frame are computed (gamma_correct_tiles),
+// their number is printed for every frame.
+// Prints the frames per second at the end.
+int gamma_correct_frames(int inputFd, int outputFd, gammaPlan* plan, threadPool* pool, tileCache* tiles) {
+        frameJob job = {.inputFd = inputFd, .outputFd = outputFd};
+        int result = EXIT_FAILURE;
+        job.buffer = malloc(FRAME_BUFFER_BYTES);
+        if(!job.buffer) {
+            fprintf(stderr, "gamma_correct_frames: Malloc failed\n");
+            return EXIT_FAILURE;
+        }
+        for(int slot = 0; slot < 2; slot++) {
+            sem_init(&job.inputFree[slot], 0, 1);
+            sem_init(&job.inputReady[slot], 0, 0);
+            sem_init(&job.outputFree[slot], 0, 1);
+            sem_init(&job.outputReady[slot], 0, 0);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_t reader;
+        pthread_t writer;
+        pthread_create(&reader, NULL, readerThread, &job);
+        pthread_create(&writer, NULL, writerThread, &job);
+
+        int allocError = 0;
+        for(size_t k = 0; ; k++) {
+            int slot = k & 1;
+            frameSlot* frame = &job.slots[slot];
+
+            sem_wait(&job.inputReady[slot]);
+            sem_wait(&job.outputFree[slot]);
+            size_t pixels = (size_t)frame->width * frame->height;
+            if(!frame->last && reserveContent(&frame->output, &frame->outputCapacity, pixels) != EXIT_SUCCESS)
+                allocError = 1;
+            size_t dirtyTiles = 0;
+            if(!frame->last && !allocError && tiles != NULL && gamma_correct_tiles(tiles, plan, pool,
+                frame->input.content, frame->width, frame->height, frame->output.content, &dirtyTiles) != EXIT_SUCCESS)
+                    allocError = 1;
+            if(frame->last || allocError) {
+                // the writer stops at this slot, the reader at the next one it waits for
+                frame->outputLast = 1;
+                __atomic_store_n(&job.stop, 1, __ATOMIC_RELAXED);
+                sem_post(&job.outputReady[slot]);
+                sem_post(&job.inputFree[0]);
+                sem_post(&job.inputFree[1]);
+                break;
+            }
+
+            if(tiles != NULL) {
+                fprintf(stderr, "gamma_correct_frames: Frame %zu: %zu of %zu tiles reprocessed\n", k + 1,
+                    dirtyTiles, getTileCount(frame->width, frame->height));
+            } else {
+                uint64_t traceStart = traceNow();
+                if(pool != NULL)
+                    gamma_correct_parallel(pool, plan, frame->input.content, frame->width, frame->height,
+                        frame->output.content, 1);
+                else
+                    executeGammaPlanPadded(plan, frame->input.content, pixels, frame->output.content);
+                traceRecord("kernel", traceStart);
+            }
+            frame->outputWidth = frame->width;
+            frame->outputHeight = frame->height;
+            frame->outputLast = 0;
+
+            sem_post(&job.inputFree[slot]);
+            sem_post(&job.outputReady[slot]);
+        }
+
+        pthread_join(reader, NULL);
+        pthread_join(writer, NULL);
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+
+        if(job.readError) {
+            fprintf(stderr, "gamma_correct_frames: Could not read frame %zu\n", job.framesRead + 1);
+        } else if(job.writeError || allocError) {
+            fprintf(stderr, "gamma_correct_frames: Could not write frame %zu\n", job.frames + 1);
+        } else {
+            result = EXIT_SUCCESS;
+        }
+        fprintf(stderr, "gamma_correct_frames: Converted %zu frames in %f seconds, %.1f frames/sec\n",
+            job.frames, time, time > 0 ? job.frames / time : 0.0);
+        if(tiles != NULL && tiles->tiles > 0)
+            fprintf(stderr, "gamma_correct_frames: Reprocessed %zu of %zu tiles (%.1f%%)\n",
+                tiles->dirtyTiles, tiles->tiles, 100.0 * tiles->dirtyTiles / tiles->tiles);
+
+        for(int slot = 0; slot < 2; slot++) {
+            sem_destroy(&job.inputFree[slot]);
+            sem_destroy(&job.inputReady[slot]);
+            sem_destroy(&job.outputFree[slot]);
+            sem_destroy(&job.outputReady[slot]);
+            freeImageFile(&job.slots[slot].input);
+            freeImageFile(&job.slots[slot].output);
+        }
+        free(job.buffer);
+        return result;
+}
@@ -0,0 +1,34 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gamma_correct.h"
+#include "image_library.h"
+#include "parallel.h"
+#include "plan.h"
+#include "tiles.h"
+
+// Bytes the frame reader reads at a time for the headers, the pixels are read straight into the frame
+#define FRAME_BUFFER_BYTES (64 * 1024)
+// Longest header (with comments) a frame can have, a stream without one is not PPM
+#define MAX_FRAME_HEADER_BYTES 4096
+
+// One of the two frames in flight: the reader fills input, the calling thread computes output,
+// the writer writes it. Both buffers grow with the largest frame so far and are reused.
+typedef struct frameSlot {
+  imageFile input;
+  size_t inputCapacity;
+  unsigned int width; // frame in input, set by the reader
+  unsigned int height;
+  int last; // 1 if there is no frame in this slot (end of the input or an error)
+  imageFile output;
+  size_t outputCapacity;
+  unsigned int outputWidth; // frame in output, set by the calling thread for the writer
+  unsigned int outputHeight;
+  int outputLast;
+} frameSlot;
+
+int gamma_correct_frames(int inputFd, int outputFd, gammaPlan* plan, threadPool* pool, tileCache* tiles);
+
+#endif
@@ -6,8 +6,12 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <math.h>
+#include <float.h>
 #include "gamma_correct.h"
+#include "kernels.h"
+#include "plan.h"
 
 //-------------------------------------------------------------------
 // START NAIVE CODE
@@ -20,7 +24,7 @@ void gamma_correct_c(uint8_t* inputContent,
         // 1: Read and convert each pixel to greyscale using coefficients
         // 2: Apply gamma correction to each pixel using gamma
         // 3: Write out the result
-        for(int i = 0; i < width * height * 3; i += 3)
+        for(size_t i = 0; i < (size_t)width * height * 3; i += 3)
             *(outputContent + i/3) = gamma_correct_pixel(
                 convert_pixel_to_grayscale(
                     *(inputContent + i), 
@@ -40,7 +44,18 @@ float convert_pixel_to_grayscale(int red, int green, int blue,
 }
 
 // Approximate ln(x) for 0 <= x <= 1 using Taylor series
+// x = m * 2^e with 0.5 <= m < 1 and ln(x) = ln(m) + e * ln(2), the series of ln(m) converges
+// after a few terms (on x itself it gave -3.25 for x = 0). x = 0 gives LN_ZERO, the reduction alone
+// gives about -88 and gamma * -88 is not small enough for black to stay black at small gammas
 float calculateLn(float x) {
+    if(x == 0.0f)
+        return LN_ZERO;
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int exponent = (int)(bits >> 23) - 126;
+    bits = (bits & 0x007FFFFF) | 0x3F000000;
+    memcpy(&x, &bits, sizeof(x));
+
     x = 1.0 - x;
 
     float sum = 0.0;
@@ -51,11 +66,21 @@ float calculateLn(float x) {
         sum -= upper/i;
     }
 
-    return sum;
+    return sum + exponent * LN_2;
 }
 
-// Approximate e^x using Taylor series
+// Approximate e^x for x <= 0 using Taylor series
+// x = k * ln(2) + r with |r| <= ln(2) / 2 and e^x = 2^k * e^r, the series of e^r converges
+// after a few terms. Below -87 the result is 0 for 255 levels and 2^k stays a normal float.
 float calculateExponentalFunction(float x) {
+    if(x < -87.0f)
+        x = -87.0f;
+    int k = (int)nearbyintf(x * INV_LN_2);
+    x -= k * LN_2;
+    uint32_t bits = (uint32_t)(k + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+
     float sum = 1;
     float term = 1;
 
@@ -68,7 +93,7 @@ float calculateExponentalFunction(float x) {
     if(sum < 0)
         return 0;
 
-    return sum;
+    return sum * scale;
 }
 
 // Approximate a^b using Taylor series
@@ -86,10 +111,10 @@ void gamma_correct_c_SSE(uint8_t* inputContent,
     uint8_t* outputContent) {
 
         float toWrite[4] = {0, 0, 0, 0}; // Buffer to write out result
-        int leftOver = (width * height * 3) % 12; // How many bytes will naive implementation handle
-        int pixelsToExecute = (width * height * 3) - leftOver; // How many bytes will SSE handle
+        size_t leftOver = ((size_t)width * height * 3) % 12; // How many bytes will naive implementation handle
+        size_t pixelsToExecute = ((size_t)width * height * 3) - leftOver; // How many bytes will SSE handle
         
-        for(int i = 0; i < pixelsToExecute; i += 12) {
+        for(size_t i = 0; i < pixelsToExecute; i += 12) {
             // 1: Read RGB values of 4 pixels into 3 vectors
             float red1 = *(inputContent + i + 0);
             float green1 = *(inputContent + i + 1);
@@ -125,7 +150,7 @@ void gamma_correct_c_SSE(uint8_t* inputContent,
         }
 
         //USE NORMAL IMPLEMENTATION FOR LEFTOVERS
-        gamma_correct_c(inputContent + pixelsToExecute, leftOver, 1, 
+        gamma_correct_c(inputContent + pixelsToExecute, leftOver / 3, 1, 
             a, b, c, gamma, 
             outputContent + pixelsToExecute / 3);
 }
@@ -150,11 +175,20 @@ __m128 convert_pixel_to_grayscale_SSE(__m128 red, __m128 green, __m128 blue,
     return _mm_add_ps(_mm_add_ps(red, green), blue);
 }
 
-// Approximate ln(x) for 0 <= x[n] <= 1
+// Approximate ln(x) for 0 <= x[n] <= 1, split into m * 2^e like calculateLn
 __m128 calculateLn_SSE(__m128 x) {
     float zero = 0.0;
     float one = 1.0;
 
+    __m128 isZero = _mm_cmpeq_ps(x, _mm_setzero_ps());
+
+    // e * ln(2) and 0.5 <= m < 1
+    __m128i bits = _mm_castps_si128(x);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(126)));
+    exponent = _mm_mul_ps(exponent, _mm_set1_ps(LN_2));
+    x = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+        _mm_set1_epi32(0x3F000000)));
+
     // x = 1.0 - x;
     x = _mm_sub_ps(_mm_load1_ps(&one), x);
     
@@ -174,13 +208,20 @@ __m128 calculateLn_SSE(__m128 x) {
         sum = _mm_sub_ps(sum, _mm_div_ps(upper, _mm_load1_ps(&iFloat)));
     }
 
-    return sum;
+    // ln(0) = LN_ZERO
+    return _mm_or_ps(_mm_and_ps(isZero, _mm_set1_ps(LN_ZERO)), _mm_andnot_ps(isZero, _mm_add_ps(sum, exponent)));
 }
 
-// Approximate e^x[n]
+// Approximate e^x[n] for x[n] <= 0, split into 2^k * e^r like calculateExponentalFunction
 __m128 calculateExponentalFunction_SSE(__m128 x) {
     float one = 1.0;
 
+    // r and 2^k (cvtps2dq rounds to nearest like nearbyintf)
+    x = _mm_max_ps(x, _mm_set1_ps(-87.0f));
+    __m128i k = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(INV_LN_2)));
+    x = _mm_sub_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(k), _mm_set1_ps(LN_2)));
+    __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(k, _mm_set1_epi32(127)), 23));
+
     //float sum = 1;
     __m128 sum = _mm_load1_ps(&one);
 
@@ -200,7 +241,7 @@ __m128 calculateExponentalFunction_SSE(__m128 x) {
         sum =  _mm_add_ps(sum, term);
     }
 
-    return _mm_max_ps (sum, _mm_set_ps(0, 0, 0, 0));
+    return _mm_mul_ps(_mm_max_ps (sum, _mm_set_ps(0, 0, 0, 0)), scale);
 }
 
 // Approximate a[n]^b[n]
@@ -218,7 +259,7 @@ __m128 power_SSE(__m128 a, __m128 b) {
 void gamma_correct_c_naiv(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent) {
-        for (int i = 0; i < width * height * 3; i += 3) {
+        for (size_t i = 0; i < (size_t)width * height * 3; i += 3) {
             *(outputContent + i/3) = powf(
                 convert_pixel_to_grayscale(
                     *(inputContent + i), 
@@ -227,6 +268,14 @@ void gamma_correct_c_naiv(uint8_t* inputContent,
         }
 }
 
+// Table of (v / 255)^gamma * 255 for every byte v in double precision, truncated like the implementations
+// (the small offset keeps exact results like gamma 1 from being truncated to v - 1)
+// Used where there is no hash implementation to take the table from (color mode, see gamma_correct_color_table)
+void gamma_correct_build_table_exact(uint8_t* table, float gamma) {
+    for (int v = 0; v < 256; v++)
+        table[v] = pow(v / 255.0, gamma) * 255.0 + 1e-9;
+}
+
 //-------------------------------------------------------------------
 // START HASH CODE
 //-------------------------------------------------------------------
@@ -235,18 +284,51 @@ void gamma_correct_c_naiv(uint8_t* inputContent,
 void gamma_correct_c_hash(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent) {
-        // hash table for storing results
-        uint8_t hash[256] = {0};
-        
-        uint8_t tempKey = 0;
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
 
-        // gamma correct all possible values
-        for (int i = 0; i < 256; i++) 
-        {
-            hash[i] = gamma_correct_pixel(i, gamma);
-        }
+// Gamma correction using the hash C SSE Implementation
+void gamma_correct_c_hash_SSE(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_SSE], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+// Fills the hash table of gamma_correct_c_hash
+void gamma_correct_c_build_hash(uint8_t* hash, float gamma) {
+    // gamma correct all possible values
+    for (int i = 0; i < 256; i++) 
+    {
+        hash[i] = gamma_correct_pixel(i, gamma);
+    }
+}
+
+// Fills the hash table of gamma_correct_c_hash_SSE
+void gamma_correct_c_build_hash_SSE(uint8_t* hash, float gamma) {
+    float toWrite[4] = {0, 0, 0, 0};
+
+    // gamma correct all possible values
+    for (int i = 0; i < 256; i+=4) 
+    {
+        _mm_storeu_ps(toWrite, gamma_correct_pixel_SSE(_mm_set_ps(i, i+1, i+2, i+3), gamma));
+        hash[i] = toWrite[3];
+        hash[i+1] = toWrite[2];
+        hash[i+2] = toWrite[1];
+        hash[i+3] = toWrite[0];
+    }
+}
+
+// Gamma correction of all pixels with an already filled hash table
+void gamma_correct_c_hash_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        uint8_t tempKey = 0;
 
-        for (int i = 0; i < width * height * 3; i += 3) {
+        for (size_t i = 0; i < (size_t)width * height * 3; i += 3) {
             // convert pixel to grayscale
             tempKey = convert_pixel_to_grayscale(
                     *(inputContent + i), 
@@ -257,32 +339,825 @@ void gamma_correct_c_hash(uint8_t* inputContent,
         }
 }
 
-// Gamma correction using the hash C SSE Implementation
-void gamma_correct_c_hash_SSE(uint8_t* inputContent, 
+// Gamma correction with a table of all RGB triples, no arithmetic at all
+// The table is 16 MiB, so this only pays off if the image uses few colors (the used lines stay in cache)
+// or the arithmetic is expensive
+void gamma_correct_rgb_table(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t* rgbTable) {
+        size_t pixels = (size_t)width * height;
+
+        for (size_t i = 0; i < pixels; i++) {
+            uint8_t* pixel = inputContent + i * 3;
+            outputContent[i] = rgbTable[((uint32_t)pixel[0] << 16) | ((uint32_t)pixel[1] << 8) | pixel[2]];
+        }
+}
+
+// Second half of the hash implementations for several gammas: the keys are computed once,
+// then looked up in the packed tables, one load gives the outputs of 4 gammas
+void gamma_correct_fan_out(uint8_t* keys, int pixels, 
+    uint32_t (*packedHashes)[256], uint8_t** outputContents, int count) {
+        for (int k = 0; k < count; k += 4) {
+            uint32_t* packed = packedHashes[k / 4];
+            int groupCount = count - k < 4 ? count - k : 4;
+            for (int i = 0; i < pixels; i++) {
+                uint32_t entry = packed[keys[i]];
+                for (int j = 0; j < groupCount; j++)
+                    outputContents[k + j][i] = entry >> (8 * j);
+            }
+        }
+}
+
+//-------------------------------------------------------------------
+// START AVX CODE
+//-------------------------------------------------------------------
+// These functions are compiled for AVX2/AVX-512 only (target attribute),
+// so they may only be called after checking the CPU (see kernels.c).
+// They give the same results as gamma_correct_asm_hash_simd:
+// same table and every product is truncated before adding them up like in .Lhashloop
+
+// Grayscale keys of the 8 pixels (24 bytes) at pixels as 32 bit integers
+__attribute__((target("avx2")))
+static inline __m256i convert_pixels_to_keys_AVX2(uint8_t* pixels, 
+    __m256 a, __m256 b, __m256 c) {
+        // low lane holds pixel 1-4 in bytes 0-11, high lane holds pixel 5-8 in bytes 4-15
+        // (loaded from pixels + 8 so we never read behind the 24 bytes)
+        const __m256i maskR = _mm256_setr_epi8(
+            0,-1,-1,-1, 3,-1,-1,-1, 6,-1,-1,-1, 9,-1,-1,-1,
+            4,-1,-1,-1, 7,-1,-1,-1, 10,-1,-1,-1, 13,-1,-1,-1);
+        const __m256i maskG = _mm256_setr_epi8(
+            1,-1,-1,-1, 4,-1,-1,-1, 7,-1,-1,-1, 10,-1,-1,-1,
+            5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1, 14,-1,-1,-1);
+        const __m256i maskB = _mm256_setr_epi8(
+            2,-1,-1,-1, 5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1,
+            6,-1,-1,-1, 9,-1,-1,-1, 12,-1,-1,-1, 15,-1,-1,-1);
+
+        __m256i rgb = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((__m128i*)pixels)),
+            _mm_loadu_si128((__m128i*)(pixels + 8)), 1);
+
+        __m256i red = _mm256_cvttps_epi32(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskR)), a));
+        __m256i green = _mm256_cvttps_epi32(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskG)), b));
+        __m256i blue = _mm256_cvttps_epi32(_mm256_mul_ps(
+            _mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskB)), c));
+
+        return _mm256_add_epi32(_mm256_add_epi32(red, green), blue);
+}
+
+// Gamma correction using the hash AVX2 Implementation (32 pixels per iteration)
+__attribute__((target("avx2")))
+void gamma_correct_c_hash_AVX2_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+
+        __m256 aVector = _mm256_set1_ps(a);
+        __m256 bVector = _mm256_set1_ps(b);
+        __m256 cVector = _mm256_set1_ps(c);
+
+        // the hash table in 16 chunks of 16 bytes, each chunk in both lanes
+        __m256i chunks[16];
+        for (int k = 0; k < 16; k++) {
+            chunks[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(hash + 16 * k)));
+        }
+
+        for (; i + 32 <= pixels; i += 32) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Calculate 4 x 8 keys and pack them into bytes
+            // packs works per lane, so the 4 byte groups have to be put back into pixel order
+            __m256i keys = _mm256_packus_epi16(
+                _mm256_packs_epi32(
+                    convert_pixels_to_keys_AVX2(pixel, aVector, bVector, cVector),
+                    convert_pixels_to_keys_AVX2(pixel + 24, aVector, bVector, cVector)),
+                _mm256_packs_epi32(
+                    convert_pixels_to_keys_AVX2(pixel + 48, aVector, bVector, cVector),
+                    convert_pixels_to_keys_AVX2(pixel + 72, aVector, bVector, cVector)));
+            keys = _mm256_permutevar8x32_epi32(keys, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+            // 2: Look up all keys, one 16 byte chunk of the table at a time
+            // offset = key - 16 * k is in [0, 16) only for keys of chunk k,
+            // adding 0x70 with saturation sets bit 7 (shuffle writes 0) for all other keys
+            __m256i result = _mm256_setzero_si256();
+            __m256i offset = keys;
+            for (int k = 0; k < 16; k++) {
+                __m256i index = _mm256_adds_epu8(offset, _mm256_set1_epi8(0x70));
+                result = _mm256_or_si256(result, _mm256_shuffle_epi8(chunks[k], index));
+                offset = _mm256_sub_epi8(offset, _mm256_set1_epi8(0x10));
+            }
+
+            // 3: Write out the result
+            _mm256_storeu_si256((__m256i*)(outputContent + i), result);
+        }
+
+        //USE SCALAR HASH LOOP FOR LEFTOVERS
+        gamma_correct_asm_hash_table(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, outputContent + i, hash);
+}
+
+// Gamma correction using the hash AVX2 Implementation
+void gamma_correct_c_hash_AVX2(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent) {
-        // hash table for storing results
-        uint8_t tempKey;
-        uint8_t hash[256] = {0};
-        float toWrite[4] = {0, 0, 0, 0};
-
-        // gamma correct all possible values
-        for (int i = 0; i < 256; i+=4) 
-        {
-            _mm_storeu_ps(toWrite, gamma_correct_pixel_SSE(_mm_set_ps(i, i+1, i+2, i+3), gamma));
-            hash[i] = toWrite[3];
-            hash[i+1] = toWrite[2];
-            hash[i+2] = toWrite[1];
-            hash[i+3] = toWrite[0];
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_AVX2], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+// Same as gamma_correct_fan_out, 8 pixels at a time:
+// gather the packed entries of 8 keys and transpose them to 8 bytes per gamma
+__attribute__((target("avx2")))
+void gamma_correct_fan_out_AVX2(uint8_t* keys, int pixels, 
+    uint32_t (*packedHashes)[256], uint8_t** outputContents, int count) {
+        // in every lane: gamma 0 of the 4 pixels, then gamma 1, 2 and 3
+        const __m256i byGamma = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15));
+        // gamma 0 of pixels 0-3 and 4-7 next to each other, then gamma 1, 2 and 3
+        const __m256i joinLanes = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        int i = 0;
+
+        for (; i + 8 <= pixels; i += 8) {
+            __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*)(keys + i)));
+            for (int k = 0; k < count; k += 4) {
+                __m256i entries = _mm256_i32gather_epi32((int*)packedHashes[k / 4], indices, 4);
+                entries = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(entries, byGamma), joinLanes);
+                __m128i low = _mm256_castsi256_si128(entries);
+                __m128i high = _mm256_extracti128_si256(entries, 1);
+                _mm_storel_epi64((__m128i*)(outputContents[k] + i), low);
+                if (k + 1 < count)
+                    _mm_storel_epi64((__m128i*)(outputContents[k + 1] + i), _mm_unpackhi_epi64(low, low));
+                if (k + 2 < count)
+                    _mm_storel_epi64((__m128i*)(outputContents[k + 2] + i), high);
+                if (k + 3 < count)
+                    _mm_storel_epi64((__m128i*)(outputContents[k + 3] + i), _mm_unpackhi_epi64(high, high));
+            }
         }
 
-        for (int i = 0; i < width * height * 3; i += 3) {
-            // convert pixel to grayscale
-            tempKey = convert_pixel_to_grayscale(
+        // remaining pixels
+        if (i < pixels) {
+            uint8_t* outputs[MAX_GAMMAS];
+            for (int k = 0; k < count; k++)
+                outputs[k] = outputContents[k] + i;
+            gamma_correct_fan_out(keys + i, pixels - i, packedHashes, outputs, count);
+        }
+}
+
+// Grayscale keys of the 16 pixels (48 bytes) at pixels as bytes
+__attribute__((target("avx512f,avx512bw")))
+static inline __m128i convert_pixels_to_keys_AVX512(uint8_t* pixels, 
+    __m512 a, __m512 b, __m512 c) {
+        // every lane gets 4 pixels in bytes 0-11
+        const __m512i maskR = _mm512_broadcast_i32x4(_mm_setr_epi8(
+            0,-1,-1,-1, 3,-1,-1,-1, 6,-1,-1,-1, 9,-1,-1,-1));
+        const __m512i maskG = _mm512_broadcast_i32x4(_mm_setr_epi8(
+            1,-1,-1,-1, 4,-1,-1,-1, 7,-1,-1,-1, 10,-1,-1,-1));
+        const __m512i maskB = _mm512_broadcast_i32x4(_mm_setr_epi8(
+            2,-1,-1,-1, 5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1));
+        const __m512i lanes = _mm512_setr_epi32(
+            0, 1, 2, 3, 3, 4, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12);
+
+        // masked load of exactly 48 bytes, then spread them to the 4 lanes in 12 byte steps
+        __m512i rgb = _mm512_maskz_loadu_epi8(0xFFFFFFFFFFFFULL, pixels);
+        rgb = _mm512_permutexvar_epi32(lanes, rgb);
+
+        __m512i red = _mm512_cvttps_epi32(_mm512_mul_ps(
+            _mm512_cvtepi32_ps(_mm512_shuffle_epi8(rgb, maskR)), a));
+        __m512i green = _mm512_cvttps_epi32(_mm512_mul_ps(
+            _mm512_cvtepi32_ps(_mm512_shuffle_epi8(rgb, maskG)), b));
+        __m512i blue = _mm512_cvttps_epi32(_mm512_mul_ps(
+            _mm512_cvtepi32_ps(_mm512_shuffle_epi8(rgb, maskB)), c));
+
+        return _mm512_cvtepi32_epi8(_mm512_add_epi32(_mm512_add_epi32(red, green), blue));
+}
+
+// Gamma correction using the hash AVX-512 Implementation (64 pixels per iteration)
+__attribute__((target("avx512f,avx512bw")))
+void gamma_correct_c_hash_AVX512_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+
+        __m512 aVector = _mm512_set1_ps(a);
+        __m512 bVector = _mm512_set1_ps(b);
+        __m512 cVector = _mm512_set1_ps(c);
+
+        // the hash table in 16 chunks of 16 bytes, each chunk in all 4 lanes
+        __m512i chunks[16];
+        for (int k = 0; k < 16; k++) {
+            chunks[k] = _mm512_broadcast_i32x4(_mm_loadu_si128((__m128i*)(hash + 16 * k)));
+        }
+
+        for (; i + 64 <= pixels; i += 64) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Calculate 4 x 16 keys
+            __m512i keys = _mm512_castsi128_si512(
+                convert_pixels_to_keys_AVX512(pixel, aVector, bVector, cVector));
+            keys = _mm512_inserti32x4(keys, 
+                convert_pixels_to_keys_AVX512(pixel + 48, aVector, bVector, cVector), 1);
+            keys = _mm512_inserti32x4(keys, 
+                convert_pixels_to_keys_AVX512(pixel + 96, aVector, bVector, cVector), 2);
+            keys = _mm512_inserti32x4(keys, 
+                convert_pixels_to_keys_AVX512(pixel + 144, aVector, bVector, cVector), 3);
+
+            // 2: Look up all keys, chunk k of the table is used for keys with high nibble k
+            __m512i low = _mm512_and_si512(keys, _mm512_set1_epi8(0x0F));
+            __m512i high = _mm512_and_si512(_mm512_srli_epi16(keys, 4), _mm512_set1_epi8(0x0F));
+            __m512i result = _mm512_setzero_si512();
+            for (int k = 0; k < 16; k++) {
+                __mmask64 inChunk = _mm512_cmpeq_epi8_mask(high, _mm512_set1_epi8(k));
+                result = _mm512_mask_shuffle_epi8(result, inChunk, chunks[k], low);
+            }
+
+            // 3: Write out the result
+            _mm512_storeu_si512((__m512i*)(outputContent + i), result);
+        }
+
+        //USE SCALAR HASH LOOP FOR LEFTOVERS
+        gamma_correct_asm_hash_table(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, outputContent + i, hash);
+}
+
+// Gamma correction using the hash AVX-512 Implementation
+void gamma_correct_c_hash_AVX512(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_AVX512], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+//-------------------------------------------------------------------
+// START FIXED POINT CODE
+//-------------------------------------------------------------------
+// The grayscale key is calculated with integers only:
+// key = (red * A + green * B + blue * C) >> FIXED_SHIFT
+// with A, B, C = a, b, c * 2^FIXED_SHIFT rounded (A + B + C = 2^FIXED_SHIFT).
+// Rounding leaves two weights at most 1/2^15 off, the largest one gets the rest and is at most 1/2^14 off.
+// The errors add up to 0 (A + B + C = 2^FIXED_SHIFT), so the integer sum is at most 255/2^14 < 0.016 off
+// the exact one. Compared to convert_pixel_to_grayscale (gamma_correct_c_hash) the key differs by at most 1,
+// and only for pixels whose exact grayscale value is less than 0.016 away from a whole number.
+// The output is then the neighbouring entry of the hash table.
+// pmaddwd is used instead of pmaddubsw: its 8 bit weights (FIXED_SHIFT 7) would be up to 3 keys off.
+
+// Converts normalized coefficients to fixed point weights that add up to 2^FIXED_SHIFT
+void convert_coeffs_to_fixed(float a, float b, float c, int16_t* weights) {
+    int one = 1 << FIXED_SHIFT;
+    int abc[3];
+    int largest = 0;
+
+    abc[0] = a * one + 0.5f;
+    abc[1] = b * one + 0.5f;
+    abc[2] = c * one + 0.5f;
+
+    // put the rounding error on the largest weight so white stays white
+    for (int i = 1; i < 3; i++) {
+        if (abc[i] > abc[largest])
+            largest = i;
+    }
+    abc[largest] += one - (abc[0] + abc[1] + abc[2]);
+
+    for (int i = 0; i < 3; i++) {
+        weights[i] = abc[i];
+    }
+}
+
+// Gamma correction of all pixels with integer keys and an already filled hash table
+void gamma_correct_c_hash_fixed_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        int16_t weights[3];
+        convert_coeffs_to_fixed(a, b, c, weights);
+
+        for (size_t i = 0; i < (size_t)width * height * 3; i += 3) {
+            int key = (*(inputContent + i) * weights[0]
+                + *(inputContent + i + 1) * weights[1]
+                + *(inputContent + i + 2) * weights[2]) >> FIXED_SHIFT;
+            *(outputContent + i/3) = hash[key];
+        }
+}
+
+// Gamma correction using the fixed point hash C Implementation
+void gamma_correct_c_hash_fixed(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_FIXED], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+// Integer keys of the 4 pixels in the lowest 12 bytes of rgb as 32 bit integers
+// red/green are zero extended into word pairs and blue into (blue, 0) pairs, so pmaddwd adds them up
+__attribute__((target("ssse3")))
+static inline __m128i convert_pixels_to_fixed_keys_SSE(__m128i rgb, 
+    __m128i weightsRG, __m128i weightsB) {
+        const __m128i maskRG = _mm_setr_epi8(
+            0,-1,1,-1, 3,-1,4,-1, 6,-1,7,-1, 9,-1,10,-1);
+        const __m128i maskB = _mm_setr_epi8(
+            2,-1,-1,-1, 5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1);
+
+        __m128i sum = _mm_add_epi32(
+            _mm_madd_epi16(_mm_shuffle_epi8(rgb, maskRG), weightsRG),
+            _mm_madd_epi16(_mm_shuffle_epi8(rgb, maskB), weightsB));
+        return _mm_srli_epi32(sum, FIXED_SHIFT);
+}
+
+// Gamma correction using the fixed point hash SSE Implementation (16 pixels per iteration)
+__attribute__((target("ssse3")))
+void gamma_correct_c_hash_fixed_SSE_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+        int16_t weights[3];
+        convert_coeffs_to_fixed(a, b, c, weights);
+
+        __m128i weightsRG = _mm_setr_epi16(weights[0], weights[1], weights[0], weights[1], 
+            weights[0], weights[1], weights[0], weights[1]);
+        __m128i weightsB = _mm_setr_epi16(weights[2], 0, weights[2], 0, 
+            weights[2], 0, weights[2], 0);
+
+        for (; i + 16 <= pixels; i += 16) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Load 16 pixels and calculate the keys of 4 groups of 4 pixels (12 bytes)
+            __m128i rgb0 = _mm_loadu_si128((__m128i*)pixel);
+            __m128i rgb1 = _mm_loadu_si128((__m128i*)(pixel + 16));
+            __m128i rgb2 = _mm_loadu_si128((__m128i*)(pixel + 32));
+
+            __m128i keys = _mm_packus_epi16(
+                _mm_packs_epi32(
+                    convert_pixels_to_fixed_keys_SSE(rgb0, weightsRG, weightsB),
+                    convert_pixels_to_fixed_keys_SSE(_mm_alignr_epi8(rgb1, rgb0, 12), weightsRG, weightsB)),
+                _mm_packs_epi32(
+                    convert_pixels_to_fixed_keys_SSE(_mm_alignr_epi8(rgb2, rgb1, 8), weightsRG, weightsB),
+                    convert_pixels_to_fixed_keys_SSE(_mm_srli_si128(rgb2, 4), weightsRG, weightsB)));
+
+            // 2: Look up all keys, one 16 byte chunk of the table at a time (see gamma_correct_c_hash_AVX2_table)
+            __m128i result = _mm_setzero_si128();
+            __m128i offset = keys;
+            for (int k = 0; k < 16; k++) {
+                __m128i index = _mm_adds_epu8(offset, _mm_set1_epi8(0x70));
+                result = _mm_or_si128(result, 
+                    _mm_shuffle_epi8(_mm_loadu_si128((__m128i*)(hash + 16 * k)), index));
+                offset = _mm_sub_epi8(offset, _mm_set1_epi8(0x10));
+            }
+
+            // 3: Write out the result
+            _mm_storeu_si128((__m128i*)(outputContent + i), result);
+        }
+
+        //USE SCALAR FIXED POINT LOOP FOR LEFTOVERS
+        gamma_correct_c_hash_fixed_table(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, outputContent + i, hash);
+}
+
+// Gamma correction using the fixed point hash SSE Implementation
+void gamma_correct_c_hash_fixed_SSE(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_FIXED_SSE], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+// Integer keys of the 8 pixels (24 bytes) at pixels as 32 bit integers
+__attribute__((target("avx2")))
+static inline __m256i convert_pixels_to_fixed_keys_AVX2(uint8_t* pixels, 
+    __m256i weightsRG, __m256i weightsB) {
+        // low lane holds pixel 1-4 in bytes 0-11, high lane holds pixel 5-8 in bytes 4-15
+        const __m256i maskRG = _mm256_setr_epi8(
+            0,-1,1,-1, 3,-1,4,-1, 6,-1,7,-1, 9,-1,10,-1,
+            4,-1,5,-1, 7,-1,8,-1, 10,-1,11,-1, 13,-1,14,-1);
+        const __m256i maskB = _mm256_setr_epi8(
+            2,-1,-1,-1, 5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1,
+            6,-1,-1,-1, 9,-1,-1,-1, 12,-1,-1,-1, 15,-1,-1,-1);
+
+        __m256i rgb = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((__m128i*)pixels)),
+            _mm_loadu_si128((__m128i*)(pixels + 8)), 1);
+
+        __m256i sum = _mm256_add_epi32(
+            _mm256_madd_epi16(_mm256_shuffle_epi8(rgb, maskRG), weightsRG),
+            _mm256_madd_epi16(_mm256_shuffle_epi8(rgb, maskB), weightsB));
+        return _mm256_srli_epi32(sum, FIXED_SHIFT);
+}
+
+// Gamma correction using the fixed point hash AVX2 Implementation (32 pixels per iteration)
+__attribute__((target("avx2")))
+void gamma_correct_c_hash_fixed_AVX2_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+        int16_t weights[3];
+        convert_coeffs_to_fixed(a, b, c, weights);
+
+        __m256i weightsRG = _mm256_set1_epi32((uint16_t)weights[0] | (weights[1] << 16));
+        __m256i weightsB = _mm256_set1_epi32(weights[2]);
+
+        // the hash table in 16 chunks of 16 bytes, each chunk in both lanes
+        __m256i chunks[16];
+        for (int k = 0; k < 16; k++) {
+            chunks[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(hash + 16 * k)));
+        }
+
+        for (; i + 32 <= pixels; i += 32) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Calculate 4 x 8 keys and pack them into bytes in pixel order
+            __m256i keys = _mm256_packus_epi16(
+                _mm256_packs_epi32(
+                    convert_pixels_to_fixed_keys_AVX2(pixel, weightsRG, weightsB),
+                    convert_pixels_to_fixed_keys_AVX2(pixel + 24, weightsRG, weightsB)),
+                _mm256_packs_epi32(
+                    convert_pixels_to_fixed_keys_AVX2(pixel + 48, weightsRG, weightsB),
+                    convert_pixels_to_fixed_keys_AVX2(pixel + 72, weightsRG, weightsB)));
+            keys = _mm256_permutevar8x32_epi32(keys, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+            // 2: Look up all keys, one 16 byte chunk of the table at a time
+            __m256i result = _mm256_setzero_si256();
+            __m256i offset = keys;
+            for (int k = 0; k < 16; k++) {
+                __m256i index = _mm256_adds_epu8(offset, _mm256_set1_epi8(0x70));
+                result = _mm256_or_si256(result, _mm256_shuffle_epi8(chunks[k], index));
+                offset = _mm256_sub_epi8(offset, _mm256_set1_epi8(0x10));
+            }
+
+            // 3: Write out the result
+            _mm256_storeu_si256((__m256i*)(outputContent + i), result);
+        }
+
+        //USE SCALAR FIXED POINT LOOP FOR LEFTOVERS
+        gamma_correct_c_hash_fixed_table(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, outputContent + i, hash);
+}
+
+// Gamma correction using the fixed point hash AVX2 Implementation
+void gamma_correct_c_hash_fixed_AVX2(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[KERNEL_C_HASH_FIXED_AVX2], a, b, c, gamma);
+        executeGammaPlan(&plan, inputContent, width, height, outputContent);
+}
+
+//-------------------------------------------------------------------
+// START FAST POWER CODE
+//-------------------------------------------------------------------
+// x^gamma = 2^(gamma * log2(x)) without a single divide:
+// log2: x = m * 2^e with m in [sqrt(0.5), sqrt(2)) read from the float bits,
+//       log2(x) = e + f * P(f) with f = m - 1 and P of degree 8
+// exp2: t = n + r with n = round(t) and r in [-0.5, 0.5],
+//       2^t = Q(r) * 2^n, 2^n is added to the exponent bits of Q(r)
+// P and Q are interpolated at Chebyshev nodes (close to minimax):
+// |log2 error| < 2.1e-8 and relative 2^r error < 1.9e-8.
+// Compared to powf for all x = k / 65536 in (0, 1] the result is at most 5 ULP off for gamma <= 1,
+// 22 ULP for gamma <= 4 and 78 ULP for gamma = 10 (the rounding of gamma * log2(x) to a float
+// dominates). 78 ULP are < 5e-6 relative or < 0.0012 of 255, so after truncating to a byte 
+// only results that are almost exactly a whole number can differ from gamma_correct_c_naiv.
+// The SIMD versions do the same float operations in the same order as the scalar one,
+// so all of them give the same bytes.
+
+#define FAST_SQRT2 1.41421356f
+#define FAST_SQRT2_MANTISSA 0x003504f3 // mantissa bits of FAST_SQRT2
+#define FAST_EXP2_MIN -125.0f // smallest 2^n with a normal Q(r) * 2^n, the output is 0 anyway
+// log2(0): gamma * log2(0) has to be below FAST_EXP2_MIN for every gamma > 0, so black stays black
+// (gamma 0 gives 0 * -FLT_MAX = 0 and 2^0 = 1 like powf(0, 0))
+#define FAST_LOG2_ZERO -FLT_MAX
+
+static const float log2Coeffs[9] = {
+    1.4426950216293335f, -0.721347451210022f, 0.4809107482433319f, 
+    -0.3606932759284973f, 0.2879032492637634f, -0.2391698807477951f, 
+    0.21607822179794312f, -0.2058618813753128f, 0.12310968339443207f
+};
+static const float exp2Coeffs[7] = {
+    1.0f, 0.6931471824645996f, 0.24022650718688965f, 0.05550327152013779f, 
+    0.009618056938052177f, 0.0013400427997112274f, 0.00015461444854736328f
+};
+
+// Approximate log2(x) for 0 <= x (log2(0) is FAST_LOG2_ZERO)
+static inline float fast_log2(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+
+    // m > sqrt(2) is compared on the mantissa bits and m is halved in the exponent bits,
+    // a branch would be mispredicted for half of the pixels
+    uint32_t large = (bits & 0x007fffff) > FAST_SQRT2_MANTISSA;
+    int exponent = (int)(bits >> 23) - 127 + large;
+    bits = ((bits & 0x007fffff) | 0x3f800000) - (large << 23);
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    float f = m - 1.0f;
+    float p = log2Coeffs[8];
+    for(int k = 7; k >= 0; k--)
+        p = p * f + log2Coeffs[k];
+    return x == 0.0f ? FAST_LOG2_ZERO : (float)exponent + f * p;
+}
+
+// Approximate 2^t for t <= 1
+static inline float fast_exp2(float t) {
+    if(t < FAST_EXP2_MIN)
+        t = FAST_EXP2_MIN;
+
+    // adding and subtracting 1.5 * 2^23 rounds to nearest like cvtps2dq (and is no library call)
+    float rounded = (t + 12582912.0f) - 12582912.0f;
+    int n = (int)rounded;
+    float r = t - rounded;
+    float q = exp2Coeffs[6];
+    for(int k = 5; k >= 0; k--)
+        q = q * r + exp2Coeffs[k];
+
+    uint32_t bits;
+    memcpy(&bits, &q, sizeof(bits));
+    bits += (uint32_t)n << 23;
+    memcpy(&q, &bits, sizeof(q));
+    return q;
+}
+
+// Approximate a^b for 0 <= a <= 1
+float fast_power(float a, float b) {
+    return fast_exp2(b * fast_log2(a));
+}
+
+// Gamma correction using the fast power C Implementation
+void gamma_correct_c_fastpow(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        for(size_t i = 0; i < (size_t)width * height * 3; i += 3)
+            *(outputContent + i/3) = fast_power(
+                convert_pixel_to_grayscale(
                     *(inputContent + i), 
                     *(inputContent + i + 1), 
-                    *(inputContent + i + 2), a, b, c);
-            // use grayscale value as key for the hashtable
-            *(outputContent + i/3) = hash[tempKey];
+                    *(inputContent + i + 2), a, b, c) * (1.0f / 255.0f), gamma) * 255.0f;
+}
+
+// Approximate log2(x[n]) for 0 <= x[n] (log2(0) is FAST_LOG2_ZERO)
+__m128 fast_log2_SSE(__m128 x) {
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponent = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+    __m128 m = _mm_castsi128_ps(_mm_or_si128(
+        _mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+
+    // if(m > sqrt(2)) { m *= 0.5; exponent++; } (the mask is -1)
+    __m128 large = _mm_cmpgt_ps(m, _mm_set1_ps(FAST_SQRT2));
+    m = _mm_or_ps(_mm_and_ps(large, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(large, m));
+    exponent = _mm_sub_epi32(exponent, _mm_castps_si128(large));
+
+    __m128 f = _mm_sub_ps(m, _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(log2Coeffs[8]);
+    for(int k = 7; k >= 0; k--)
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(log2Coeffs[k]));
+    __m128 result = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(f, p));
+    __m128 zero = _mm_cmpeq_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(zero, _mm_set1_ps(FAST_LOG2_ZERO)), _mm_andnot_ps(zero, result));
+}
+
+// Approximate 2^t[n] for t[n] <= 1
+__m128 fast_exp2_SSE(__m128 t) {
+    t = _mm_max_ps(t, _mm_set1_ps(FAST_EXP2_MIN));
+
+    __m128i n = _mm_cvtps_epi32(t);
+    __m128 r = _mm_sub_ps(t, _mm_cvtepi32_ps(n));
+    __m128 q = _mm_set1_ps(exp2Coeffs[6]);
+    for(int k = 5; k >= 0; k--)
+        q = _mm_add_ps(_mm_mul_ps(q, r), _mm_set1_ps(exp2Coeffs[k]));
+
+    return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(q), _mm_slli_epi32(n, 23)));
+}
+
+// Approximate a[n]^b[n] for 0 <= a[n] <= 1
+__m128 fast_power_SSE(__m128 a, __m128 b) {
+    return fast_exp2_SSE(_mm_mul_ps(b, fast_log2_SSE(a)));
+}
+
+// Grayscale values of 4 pixels as floats, rgb holds them in bytes first to first + 11
+__attribute__((target("ssse3")))
+static inline __m128 convert_pixels_to_grayscale_SSE(__m128i rgb, char first, 
+    __m128 a, __m128 b, __m128 c) {
+        __m128i maskR = _mm_add_epi8(_mm_setr_epi8(
+            0,-128,-128,-128, 3,-128,-128,-128, 6,-128,-128,-128, 9,-128,-128,-128), _mm_set1_epi8(first));
+        __m128i maskG = _mm_add_epi8(maskR, _mm_set1_epi8(1));
+        __m128i maskB = _mm_add_epi8(maskR, _mm_set1_epi8(2));
+
+        __m128 red = _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(rgb, maskR)), a);
+        __m128 green = _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(rgb, maskG)), b);
+        __m128 blue = _mm_mul_ps(_mm_cvtepi32_ps(_mm_shuffle_epi8(rgb, maskB)), c);
+
+        return _mm_add_ps(_mm_add_ps(red, green), blue);
+}
+
+// Gamma correction using the fast power SSE Implementation (8 pixels per iteration)
+__attribute__((target("ssse3")))
+void gamma_correct_c_fastpow_SSE(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+
+        __m128 aVector = _mm_set1_ps(a);
+        __m128 bVector = _mm_set1_ps(b);
+        __m128 cVector = _mm_set1_ps(c);
+        __m128 gammaVector = _mm_set1_ps(gamma);
+        __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        __m128 vector255 = _mm_set1_ps(255.0f);
+
+        for(; i + 8 <= pixels; i += 8) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Read 8 pixels, pixel 5-8 are in bytes 4-15 of the second load
+            // (loaded from pixel + 8 so we never read behind the 24 bytes)
+            __m128i rgbLow = _mm_loadu_si128((__m128i*)pixel);
+            __m128i rgbHigh = _mm_loadu_si128((__m128i*)(pixel + 8));
+
+            // 2: Convert to greyscale and apply gamma correction
+            __m128 low = _mm_mul_ps(fast_power_SSE(_mm_mul_ps(
+                convert_pixels_to_grayscale_SSE(rgbLow, 0, aVector, bVector, cVector), scale), gammaVector), vector255);
+            __m128 high = _mm_mul_ps(fast_power_SSE(_mm_mul_ps(
+                convert_pixels_to_grayscale_SSE(rgbHigh, 4, aVector, bVector, cVector), scale), gammaVector), vector255);
+
+            // 3: Truncate to bytes and write out the result
+            __m128i words = _mm_packs_epi32(_mm_cvttps_epi32(low), _mm_cvttps_epi32(high));
+            _mm_storel_epi64((__m128i*)(outputContent + i), _mm_packus_epi16(words, words));
         }
-}
\ No newline at end of file
+
+        //USE SCALAR FAST POWER FOR LEFTOVERS
+        gamma_correct_c_fastpow(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, gamma, outputContent + i);
+}
+
+// Approximate log2(x[n]) for 0 <= x[n] (log2(0) is FAST_LOG2_ZERO)
+__attribute__((target("avx2")))
+static inline __m256 fast_log2_AVX2(__m256 x) {
+    __m256i bits = _mm256_castps_si256(x);
+    __m256i exponent = _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(
+        _mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+    __m256 large = _mm256_cmp_ps(m, _mm256_set1_ps(FAST_SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), large);
+    exponent = _mm256_sub_epi32(exponent, _mm256_castps_si256(large));
+
+    __m256 f = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+    __m256 p = _mm256_set1_ps(log2Coeffs[8]);
+    for(int k = 7; k >= 0; k--)
+        p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(log2Coeffs[k]));
+    __m256 result = _mm256_add_ps(_mm256_cvtepi32_ps(exponent), _mm256_mul_ps(f, p));
+    return _mm256_blendv_ps(result, _mm256_set1_ps(FAST_LOG2_ZERO), _mm256_cmp_ps(x, _mm256_setzero_ps(), _CMP_EQ_OQ));
+}
+
+// Approximate 2^t[n] for t[n] <= 1
+__attribute__((target("avx2")))
+static inline __m256 fast_exp2_AVX2(__m256 t) {
+    t = _mm256_max_ps(t, _mm256_set1_ps(FAST_EXP2_MIN));
+
+    __m256i n = _mm256_cvtps_epi32(t);
+    __m256 r = _mm256_sub_ps(t, _mm256_cvtepi32_ps(n));
+    __m256 q = _mm256_set1_ps(exp2Coeffs[6]);
+    for(int k = 5; k >= 0; k--)
+        q = _mm256_add_ps(_mm256_mul_ps(q, r), _mm256_set1_ps(exp2Coeffs[k]));
+
+    return _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(q), _mm256_slli_epi32(n, 23)));
+}
+
+// Grayscale values of the 8 pixels (24 bytes) at pixels as floats
+__attribute__((target("avx2")))
+static inline __m256 convert_pixels_to_grayscale_AVX2(uint8_t* pixels, 
+    __m256 a, __m256 b, __m256 c) {
+        // same layout as convert_pixels_to_keys_AVX2, but the products are not truncated
+        const __m256i maskR = _mm256_setr_epi8(
+            0,-1,-1,-1, 3,-1,-1,-1, 6,-1,-1,-1, 9,-1,-1,-1,
+            4,-1,-1,-1, 7,-1,-1,-1, 10,-1,-1,-1, 13,-1,-1,-1);
+        const __m256i maskG = _mm256_setr_epi8(
+            1,-1,-1,-1, 4,-1,-1,-1, 7,-1,-1,-1, 10,-1,-1,-1,
+            5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1, 14,-1,-1,-1);
+        const __m256i maskB = _mm256_setr_epi8(
+            2,-1,-1,-1, 5,-1,-1,-1, 8,-1,-1,-1, 11,-1,-1,-1,
+            6,-1,-1,-1, 9,-1,-1,-1, 12,-1,-1,-1, 15,-1,-1,-1);
+
+        __m256i rgb = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((__m128i*)pixels)),
+            _mm_loadu_si128((__m128i*)(pixels + 8)), 1);
+
+        __m256 red = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskR)), a);
+        __m256 green = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskG)), b);
+        __m256 blue = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_shuffle_epi8(rgb, maskB)), c);
+
+        return _mm256_add_ps(_mm256_add_ps(red, green), blue);
+}
+
+// Gamma correction using the fast power AVX2 Implementation (16 pixels per iteration)
+__attribute__((target("avx2")))
+void gamma_correct_c_fastpow_AVX2(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent) {
+        size_t pixels = (size_t)width * height;
+        size_t i = 0;
+
+        __m256 aVector = _mm256_set1_ps(a);
+        __m256 bVector = _mm256_set1_ps(b);
+        __m256 cVector = _mm256_set1_ps(c);
+        __m256 gammaVector = _mm256_set1_ps(gamma);
+        __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+        __m256 vector255 = _mm256_set1_ps(255.0f);
+
+        for(; i + 16 <= pixels; i += 16) {
+            uint8_t* pixel = inputContent + i * 3;
+
+            // 1: Convert 2 x 8 pixels to greyscale (two independent chains hide the latency)
+            __m256 low = _mm256_mul_ps(
+                convert_pixels_to_grayscale_AVX2(pixel, aVector, bVector, cVector), scale);
+            __m256 high = _mm256_mul_ps(
+                convert_pixels_to_grayscale_AVX2(pixel + 24, aVector, bVector, cVector), scale);
+
+            // 2: Apply gamma correction
+            low = _mm256_mul_ps(fast_exp2_AVX2(_mm256_mul_ps(gammaVector, fast_log2_AVX2(low))), vector255);
+            high = _mm256_mul_ps(fast_exp2_AVX2(_mm256_mul_ps(gammaVector, fast_log2_AVX2(high))), vector255);
+
+            // 3: Truncate to bytes and write out the result
+            // packs works per lane, so the 4 byte groups have to be put back into pixel order
+            __m256i words = _mm256_packs_epi32(_mm256_cvttps_epi32(low), _mm256_cvttps_epi32(high));
+            __m256i bytes = _mm256_packus_epi16(words, words);
+            bytes = _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+            _mm_storeu_si128((__m128i*)(outputContent + i), _mm256_castsi256_si128(bytes));
+        }
+
+        //USE SCALAR FAST POWER FOR LEFTOVERS
+        gamma_correct_c_fastpow(inputContent + i * 3, pixels - i, 1, 
+            a, b, c, gamma, outputContent + i);
+}
+
+//-------------------------------------------------------------------
+// START COLOR CODE
+//-------------------------------------------------------------------
+// Per channel gamma correction: every byte of the interleaved RGB input is looked up
+// in the table of its channel, there is no grayscale and no arithmetic
+
+// Gamma correction of every channel with its own table (tables[0] red, [1] green, [2] blue)
+void gamma_correct_color_table(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t (*tables)[256]) {
+        size_t pixels = (size_t)width * height;
+
+        for (size_t i = 0; i < pixels * 3; i += 3) {
+            outputContent[i] = tables[0][inputContent[i]];
+            outputContent[i + 1] = tables[1][inputContent[i + 1]];
+            outputContent[i + 2] = tables[2][inputContent[i + 2]];
+        }
+}
+
+// 256 entry table lookup of 64 bytes: vpermi2b looks up the low 7 bits in each 128 byte half,
+// bit 7 picks the half
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+static inline __m512i lookup_bytes_AVX512VBMI(__m512i bytes, __m512i* table) {
+    __m512i low = _mm512_permutex2var_epi8(table[0], bytes, table[1]);
+    __m512i high = _mm512_permutex2var_epi8(table[2], bytes, table[3]);
+    return _mm512_mask_blend_epi8(_mm512_movepi8_mask(bytes), low, high);
+}
+
+// Same as gamma_correct_color_table, 64 pixels (192 bytes) per iteration
+// The channel of a byte repeats every 3 vectors, so vector j takes its bytes from the 3 table lookups
+// with the same 3 masks every iteration. If all channels share one table 1 lookup is enough.
+__attribute__((target("avx512f,avx512bw,avx512vbmi")))
+void gamma_correct_color_table_AVX512VBMI(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t (*tables)[256]) {
+        size_t bytes = (size_t)width * height * 3;
+        size_t i = 0;
+        int sameTables = memcmp(tables[0], tables[1], 256) == 0 && memcmp(tables[0], tables[2], 256) == 0;
+        __m512i table[3][4];
+        __mmask64 channelMasks[3][3]; // [vector][channel]: bytes of that channel
+
+        for (int c = 0; c < 3; c++) {
+            for (int k = 0; k < 4; k++)
+                table[c][k] = _mm512_loadu_si512(tables[c] + 64 * k);
+        }
+        for (int j = 0; j < 3; j++) {
+            for (int c = 0; c < 3; c++) {
+                channelMasks[j][c] = 0;
+                for (int b = 0; b < 64; b++) {
+                    if ((64 * j + b) % 3 == c)
+                        channelMasks[j][c] |= (__mmask64)1 << b;
+                }
+            }
+        }
+
+        for (; i + 192 <= bytes; i += 192) {
+            for (int j = 0; j < 3; j++) {
+                __m512i input = _mm512_loadu_si512(inputContent + i + 64 * j);
+                __m512i output = lookup_bytes_AVX512VBMI(input, table[0]);
+                if (!sameTables) {
+                    output = _mm512_mask_blend_epi8(channelMasks[j][1], output,
+                        lookup_bytes_AVX512VBMI(input, table[1]));
+                    output = _mm512_mask_blend_epi8(channelMasks[j][2], output,
+                        lookup_bytes_AVX512VBMI(input, table[2]));
+                }
+                _mm512_storeu_si512(outputContent + i + 64 * j, output);
+            }
+        }
+
+        //USE SCALAR LOOKUP FOR LEFTOVERS
+        gamma_correct_color_table(inputContent + i, (bytes - i) / 3, 1, outputContent + i, tables);
+}
@@ -1,9 +1,18 @@
+#ifndef GAMMA_CORRECT_H
+#define GAMMA_CORRECT_H
+
 #include <stdint.h>
 #include <immintrin.h>
+#include <float.h>
 
 //-------------------------------------------------------------------
 // NAIVE C FUNCTIONS
 //-------------------------------------------------------------------
+// range reduction of the Taylor series (same float values as the .S constants)
+#define LN_2 0.693147182f
+#define INV_LN_2 1.44269502f
+// ln(0), gamma * LN_ZERO is below the clamp of the exponential function for every gamma > 0
+#define LN_ZERO -FLT_MAX
 float calculateLn(float x);
 float calculateExponentalFunction(float x);
 float power(float a, float b);
@@ -19,6 +28,18 @@ void gamma_correct_c_naiv(uint8_t* inputContent,
 void gamma_correct_c_hash(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent);
+void gamma_correct_c_hash_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+void gamma_correct_c_build_hash(uint8_t* hash, float gamma);
+void gamma_correct_build_table_exact(uint8_t* table, float gamma);
+// one load per pixel from a table with the output of all 2^24 RGB triples (see rgb_cache.c)
+void gamma_correct_rgb_table(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t* rgbTable);
+// looks up every grayscale key in the tables of count gammas, packed 4 per entry (see plan.c),
+// gamma k writes to outputContents[k]
+void gamma_correct_fan_out(uint8_t* keys, int pixels, 
+    uint32_t (*packedHashes)[256], uint8_t** outputContents, int count);
 
 //-------------------------------------------------------------------
 // ASM FUNCTIONS
@@ -32,12 +53,30 @@ void gamma_correct_asm_simd(uint8_t* inputContent,
 void gamma_correct_asm_hash(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent);
+void gamma_correct_asm_hash_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+void gamma_correct_asm_build_hash(uint8_t* hash, float gamma);
+void gamma_correct_asm_build_hash_simd(uint8_t* hash, float gamma);
 
 //gamma_correct_asm_hash_simd IS OUR MAIN IMPLEMENTATION
 void gamma_correct_asm_hash_simd(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent);
 
+// same table as gamma_correct_asm_hash_simd, but 16 pixels per iteration
+// (grayscale in packed floats and the table lookup with pshufb)
+void gamma_correct_asm_hash_simd16(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_asm_hash_simd16_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+// same results, with non-temporal stores and input prefetch for images much larger than the cache
+void gamma_correct_asm_hash_simd16_table_nt(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+
 //-------------------------------------------------------------------
 // SSE C FUNCTIONS
 //-------------------------------------------------------------------
@@ -47,9 +86,121 @@ void gamma_correct_c_SSE(uint8_t* inputContent,
 void gamma_correct_c_hash_SSE(uint8_t* inputContent, 
     int width, int height, float a, float b, float c, float gamma, 
     uint8_t* outputContent);
+void gamma_correct_c_build_hash_SSE(uint8_t* hash, float gamma);
 __m128 gamma_correct_pixel_SSE(__m128 grayscalePixel, float gamma);
 __m128 convert_pixel_to_grayscale_SSE(__m128 red, __m128 green, __m128 blue, 
     float a, float b, float c);
 __m128 calculateLn_SSE(__m128 x);
 __m128 calculateExponentalFunction_SSE(__m128 x);
-__m128 power_SSE(__m128 a, __m128 b);
\ No newline at end of file
+__m128 power_SSE(__m128 a, __m128 b);
+
+//-------------------------------------------------------------------
+// AVX C FUNCTIONS
+//-------------------------------------------------------------------
+// only call these if the CPU supports AVX2 / AVX-512BW (see kernels.h)
+void gamma_correct_c_hash_AVX2(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_c_hash_AVX2_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+void gamma_correct_c_hash_AVX512(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_c_hash_AVX512_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+void gamma_correct_fan_out_AVX2(uint8_t* keys, int pixels, 
+    uint32_t (*packedHashes)[256], uint8_t** outputContents, int count);
+
+//-------------------------------------------------------------------
+// FIXED POINT FUNCTIONS
+//-------------------------------------------------------------------
+// grayscale key = (red * A + green * B + blue * C) >> FIXED_SHIFT, no float conversions
+// the key is at most 1 off the one of gamma_correct_c_hash (see gamma_correct.c)
+#define FIXED_SHIFT 14
+void convert_coeffs_to_fixed(float a, float b, float c, int16_t* weights);
+void gamma_correct_c_hash_fixed(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_c_hash_fixed_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+// only call this if the CPU supports SSSE3
+void gamma_correct_c_hash_fixed_SSE(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_c_hash_fixed_SSE_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+// only call this if the CPU supports AVX2
+void gamma_correct_c_hash_fixed_AVX2(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+void gamma_correct_c_hash_fixed_AVX2_table(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+
+//-------------------------------------------------------------------
+// FAST POWER FUNCTIONS
+//-------------------------------------------------------------------
+// x^gamma with range reduction and short polynomials instead of Taylor series and divides
+// (error against powf see gamma_correct.c)
+float fast_power(float a, float b);
+__m128 fast_log2_SSE(__m128 x);
+__m128 fast_exp2_SSE(__m128 t);
+__m128 fast_power_SSE(__m128 a, __m128 b);
+void gamma_correct_c_fastpow(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+// only call this if the CPU supports SSSE3
+void gamma_correct_c_fastpow_SSE(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+// only call this if the CPU supports AVX2
+void gamma_correct_c_fastpow_AVX2(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+
+//-------------------------------------------------------------------
+// COLOR FUNCTIONS
+//-------------------------------------------------------------------
+// RGB in, RGB out: every channel through its own 256 entry table (tables[0] red, [1] green, [2] blue)
+void gamma_correct_color_table(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t (*tables)[256]);
+// only call this if the CPU supports AVX-512VBMI
+void gamma_correct_color_table_AVX512VBMI(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t (*tables)[256]);
+
+//-------------------------------------------------------------------
+// KERNEL DESCRIPTION
+//-------------------------------------------------------------------
+// Everything a driver needs to run one implementation.
+// The hash implementations are split into building the table and running the pixels with it,
+// so a table can be built once and shared by many calls (e.g. bands of one image).
+typedef struct gammaKernel {
+  char* name;
+  void (*function)(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, float gamma, 
+    uint8_t* outputContent);
+  // NULL for implementations without a hash table
+  void (*buildHash)(uint8_t* hash, float gamma);
+  void (*hashFunction)(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+  // CPU_* flags from kernels.h this implementation needs
+  int requiredFeatures;
+  // largest and mean |output - exact result| --verify accepts (see verify.c), for hash
+  // implementations maxError only counts the error outside of the results of the keys they may use
+  float maxError;
+  float meanError;
+  // hash implementations: how many keys below floor or above ceil of the exact grayscale the key can be
+  int keyError;
+  // NULL or a version of hashFunction with the same results that bypasses the caches,
+  // executeGammaPlan uses it for images above the streaming threshold (see plan.c)
+  void (*streamingHashFunction)(uint8_t* inputContent, 
+    int width, int height, float a, float b, float c, 
+    uint8_t* outputContent, uint8_t* hash);
+} gammaKernel;
+
+#endif
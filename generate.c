@@ -0,0 +1,153 @@
+/*
+    This file includes the generator for synthetic PPM images, so benchmarks and tests do not
+    depend on input files. Images can be built in memory or written to disk band by band.
+    Header file generate.h defines the patterns.
+*/
+
+#include "generate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char* patternNames[] = {"random", "gradient", "flat", "photo"};
+
+// Cell sizes in pixels of the two value noise octaves of PATTERN_PHOTO
+#define PHOTO_COARSE_CELL 128
+#define PHOTO_FINE_CELL 16
+
+// Sets pattern to the pattern called name, returns EXIT_FAILURE for unknown names
+int parsePattern(char* name, imagePattern* pattern) {
+    for(int i = 0; i < (int)(sizeof(patternNames) / sizeof(patternNames[0])); i++) {
+        if(strcmp(name, patternNames[i]) == 0) {
+            *pattern = i;
+            return EXIT_SUCCESS;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+char* patternName(imagePattern pattern) {
+    return patternNames[pattern];
+}
+
+// Integer hash with good avalanche (every input bit changes about half of the output bits)
+static inline uint32_t mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// Random 32 bits for position (x, y), also used for the noise grid points
+static inline uint32_t hashPosition(size_t x, size_t y, uint32_t seed) {
+    uint32_t row = mix((uint32_t)y ^ ((uint32_t)(y >> 32) * 0x9e3779b9u) ^ seed);
+    return mix((row + (uint32_t)x) ^ ((uint32_t)(x >> 32) * 0x85ebca6bu));
+}
+
+// Value noise: bilinear interpolation between random grid points, one byte per channel
+static inline int valueNoise(size_t x, size_t y, size_t cell, int channel, uint32_t seed) {
+    size_t gridX = x / cell;
+    size_t gridY = y / cell;
+    int fractionX = (x % cell) * 256 / cell;
+    int fractionY = (y % cell) * 256 / cell;
+    int shift = channel * 8;
+
+    int topLeft = hashPosition(gridX, gridY, seed) >> shift & 0xff;
+    int topRight = hashPosition(gridX + 1, gridY, seed) >> shift & 0xff;
+    int bottomLeft = hashPosition(gridX, gridY + 1, seed) >> shift & 0xff;
+    int bottomRight = hashPosition(gridX + 1, gridY + 1, seed) >> shift & 0xff;
+
+    int top = topLeft * (256 - fractionX) + topRight * fractionX;
+    int bottom = bottomLeft * (256 - fractionX) + bottomRight * fractionX;
+    return (top * (256 - fractionY) + bottom * fractionY) >> 16;
+}
+
+// Writes rows firstRow to firstRow + rowCount - 1 of a width x height image to rows (3 bytes per pixel)
+// Every row can be generated on its own, so bands give the same bytes as the whole image.
+void generateRows(uint8_t* rows, size_t width, size_t height, size_t firstRow, size_t rowCount,
+    imagePattern pattern, uint32_t seed) {
+        uint32_t flatColor = mix(seed);
+
+        for(size_t y = firstRow; y < firstRow + rowCount; y++) {
+            uint8_t* pixel = rows + (y - firstRow) * width * 3;
+            for(size_t x = 0; x < width; x++, pixel += 3) {
+                switch(pattern) {
+                    case PATTERN_RANDOM: {
+                        uint32_t random = hashPosition(x, y, seed);
+                        pixel[0] = random;
+                        pixel[1] = random >> 8;
+                        pixel[2] = random >> 16;
+                        break;
+                    }
+                    case PATTERN_GRADIENT:
+                        pixel[0] = width > 1 ? x * 255 / (width - 1) : 0;
+                        pixel[1] = height > 1 ? y * 255 / (height - 1) : 0;
+                        pixel[2] = width + height > 2 ? (x + y) * 255 / (width + height - 2) : 0;
+                        break;
+                    case PATTERN_FLAT:
+                        pixel[0] = flatColor;
+                        pixel[1] = flatColor >> 8;
+                        pixel[2] = flatColor >> 16;
+                        break;
+                    case PATTERN_PHOTO: {
+                        // grain in [-8, 7] on top of 3/4 coarse and 1/4 fine noise
+                        int grain = (hashPosition(x, y, seed ^ 0x5bd1e995u) & 15) - 8;
+                        for(int channel = 0; channel < 3; channel++) {
+                            int value = (3 * valueNoise(x, y, PHOTO_COARSE_CELL, channel, seed)
+                                + valueNoise(x, y, PHOTO_FINE_CELL, channel, ~seed)) / 4 + grain;
+                            pixel[channel] = value < 0 ? 0 : value > 255 ? 255 : value;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+}
+
+// Builds a width x height image in memory, freeImageFile frees it
+int generatePPMImage(imageFile* image, size_t width, size_t height,
+    imagePattern pattern, uint32_t seed) {
+        image->width = width;
+        image->heigth = height;
+        if(allocImageContent(image, width * height * 3) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+        generateRows(image->content, width, height, 0, height, pattern, seed);
+        return EXIT_SUCCESS;
+}
+
+// Writes a width x height image to outputName, only GENERATE_BAND_BYTES are in memory at a time
+int writeGeneratedPPMImage(char* outputName, size_t width, size_t height,
+    imagePattern pattern, uint32_t seed) {
+        size_t bandRows = GENERATE_BAND_BYTES / (width * 3 > 0 ? width * 3 : 1);
+        if(bandRows < 1)
+            bandRows = 1;
+
+        uint8_t* band = malloc(bandRows * width * 3 + 1);
+        if(!band) {
+            fprintf(stderr, "writeGeneratedPPMImage: Malloc failed\n");
+            return EXIT_FAILURE;
+        }
+        FILE* file = fopen(outputName, "wb");
+        if(!file) {
+            fprintf(stderr, "writeGeneratedPPMImage: Could not open file\n");
+            free(band);
+            return EXIT_FAILURE;
+        }
+
+        int result = fprintf(file, "P6\n%zu %zu\n255\n", width, height) > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        for(size_t y = 0; y < height && result == EXIT_SUCCESS; y += bandRows) {
+            size_t rows = height - y < bandRows ? height - y : bandRows;
+            generateRows(band, width, height, y, rows, pattern, seed);
+            if(fwrite(band, 1, rows * width * 3, file) != rows * width * 3)
+                result = EXIT_FAILURE;
+        }
+
+        if(fclose(file) != 0)
+            result = EXIT_FAILURE;
+        if(result != EXIT_SUCCESS)
+            fprintf(stderr, "writeGeneratedPPMImage: Could not write file\n");
+        free(band);
+        return result;
+}
@@ -0,0 +1,28 @@
+#ifndef GENERATE_H
+#define GENERATE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "image_library.h"
+
+// Rows generated at a time when writing to disk, so any image size needs only a few MB
+#define GENERATE_BAND_BYTES (4 * 1024 * 1024)
+
+// Content of a synthetic image, every pixel only depends on the seed and its position
+typedef enum imagePattern {
+  PATTERN_RANDOM,   // every byte uniform random
+  PATTERN_GRADIENT, // red along x, green along y, blue along the diagonal
+  PATTERN_FLAT,     // one color chosen by the seed
+  PATTERN_PHOTO     // smooth value noise in two octaves plus grain, like a photograph
+} imagePattern;
+
+int parsePattern(char* name, imagePattern* pattern);
+char* patternName(imagePattern pattern);
+void generateRows(uint8_t* rows, size_t width, size_t height, size_t firstRow, size_t rowCount,
+    imagePattern pattern, uint32_t seed);
+int generatePPMImage(imageFile* image, size_t width, size_t height,
+    imagePattern pattern, uint32_t seed);
+int writeGeneratedPPMImage(char* outputName, size_t width, size_t height,
+    imagePattern pattern, uint32_t seed);
+
+#endif
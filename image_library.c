@@ -4,181 +4,371 @@
 */
 
 #include "image_library.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 int isNewLine(char c);
-int skipWhiteSpaces(FILE **fptr);
-int parseNumber(FILE **fptr, int *store);
-int readNextChar(char *charStore, FILE **fptr);
+int skipWhiteSpaces(headerReader *reader);
+int parseNumber(headerReader *reader, int *store);
+int readNextChar(char *charStore, headerReader *reader);
+
+// Reports a header error, unless the header is only incomplete and more data can follow
+static int headerError(headerReader* reader, char* message) {
+    if(!reader->partial || !reader->truncated)
+        fprintf(stderr, "%s", message);
+    return EXIT_FAILURE;
+}
+
+// Maps fileSize bytes of fd followed by anonymous pages, so at least IMAGE_PADDING bytes after
+// the end of the file can be read and written. mappingSize is the size to unmap.
+static uint8_t* mapFilePadded(int fd, size_t fileSize, int protection, int flags, size_t* mappingSize) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t size = (fileSize + IMAGE_PADDING + pageSize - 1) / pageSize * pageSize;
+
+    uint8_t* reserved = mmap(NULL, size, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(reserved == MAP_FAILED)
+        return MAP_FAILED;
+    uint8_t* mapping = mmap(reserved, fileSize, protection, flags | MAP_FIXED, fd, 0);
+    if(mapping == MAP_FAILED) {
+        munmap(reserved, size);
+        return MAP_FAILED;
+    }
+    *mappingSize = size;
+    return mapping;
+}
 
 // PPM PARSING/READ
-// This function parses the file named "imageName" and stores in the imageFile struct "result"
+// This function maps the file named "imageName" and stores in the imageFile struct "result"
+// The header is parsed in the mapping and result->content points to the pixels in the mapping,
+// so the pixels are never copied. The content and the padding are read-only until makeImageWritable.
+// freeImageFile unmaps it again.
+// The content is padded (imageFile.padding) but not aligned, it starts right after the header.
 int readPPMImage(imageFile* result, char* imageName) {
-    FILE *fptr;
-    char charRead;
+    int fd;
+    struct stat fileStats;
+    uint64_t start = traceNow();
     
     // Try to open the file, return if cannot open
-    fptr = fopen(imageName, "rb");
-    if(!fptr) {
+    fd = open(imageName, O_RDONLY);
+    int opened = fd != -1 && fstat(fd, &fileStats) != -1;
+    traceRecord("open", start);
+    if(!opened) {
         fprintf(stderr, "readPPMImage: Could not open file\n");
+        if(fd != -1)
+            close(fd);
         return EXIT_FAILURE;
     }
 
+    // Empty files can not be mapped
+    if(fileStats.st_size == 0) {
+        fprintf(stderr, "readPPMImage: Could not read first character of magic number\n");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // Map the whole file, MAP_POPULATE reads it in one go instead of one page fault per page
+    // the mapping is read-only, so the populated pages are the page cache and nothing is copied
+    // (a writable private mapping would copy every page here), see makeImageWritable
+    start = traceNow();
+    size_t mappingSize = 0;
+    uint8_t* mapping = mapFilePadded(fd, fileStats.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, &mappingSize);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        fprintf(stderr, "readPPMImage: Could not map file\n");
+        return EXIT_FAILURE;
+    }
+    madvise(mapping, fileStats.st_size, MADV_SEQUENTIAL);
+    traceRecord("read", start);
+
+    headerReader reader = {.data = mapping, .size = fileStats.st_size};
+    size_t headerSize = 0;
+    start = traceNow();
+    int parsed = parsePPMHeader(result, &reader, &headerSize);
+    traceRecord("parse", start);
+    if(parsed != EXIT_SUCCESS) {
+        munmap(mapping, mappingSize);
+        return EXIT_FAILURE;
+    }
+
+    size_t contentSize = (size_t)result->width * result->heigth * 3;
+    size_t bytesRead = fileStats.st_size - headerSize;
+
+    // In case data read is smaller than defined in the header, return
+    if(bytesRead < contentSize) {
+        fprintf(stderr, "readPPMImage: Content smaller than defined\n");
+        munmap(mapping, mappingSize);
+        return EXIT_FAILURE;
+    }
+
+    // In case data read is larger than defined in the header, return
+    if(bytesRead > contentSize) {
+        fprintf(stderr, "readPPMImage: Content larger than defined\n");
+        munmap(mapping, mappingSize);
+        return EXIT_FAILURE;
+    }
+
+    result->content = mapping + headerSize;
+    result->mapping = mapping;
+    result->mappingSize = mappingSize;
+    result->padding = mappingSize - fileStats.st_size;
+
+    printf("readPPMImage: Data read successfull, bytes read: %zu\n", bytesRead);
+
+    return EXIT_SUCCESS;
+}
+
+// Makes the content and padding of an image of readPPMImage writable (--in-place writes the output
+// over the input). The mapping stays private: only the pages written to are copied, the file does not change.
+int makeImageWritable(imageFile* image) {
+    if(image->mapping == NULL)
+        return EXIT_SUCCESS;
+    if(mprotect(image->mapping, image->mappingSize, PROT_READ | PROT_WRITE) != 0) {
+        fprintf(stderr, "makeImageWritable: Could not make mapping writable\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Parses the P6 header at the start of reader and stores width and heigth in result
+// headerSize is set to the number of bytes up to the first pixel
+int parsePPMHeader(imageFile* result, headerReader* reader, size_t* headerSize) {
+    char charRead;
+
     // Read first char and compare to P
-    if(readNextChar(&charRead, &fptr) == EXIT_SUCCESS) {
+    if(readNextChar(&charRead, reader) == EXIT_SUCCESS) {
         if (charRead != 'P') {
-            fprintf(stderr, "readPPMImage: Image not in P6 format\n");
-            fclose(fptr);
-            return EXIT_FAILURE;
+            return headerError(reader, "readPPMImage: Image not in P6 format\n");
         }
     } 
     else {
-        fprintf(stderr, "readPPMImage: Could not read first character of magic number\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+        return headerError(reader, "readPPMImage: Could not read first character of magic number\n");
     }
 
     // Read second char and compare to 6
-    if(readNextChar(&charRead, &fptr) == EXIT_SUCCESS) {
+    if(readNextChar(&charRead, reader) == EXIT_SUCCESS) {
         if (charRead != '6') {
-            fprintf(stderr, "readPPMImage: Image not in P6 format\n");
-            fclose(fptr);
-            return EXIT_FAILURE;
+            return headerError(reader, "readPPMImage: Image not in P6 format\n");
         }
     }
     else {
-        fprintf(stderr, "readPPMImage: Could not read second character of magic number\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+        return headerError(reader, "readPPMImage: Could not read second character of magic number\n");
     }
 
     // Skip whitespaces after P6
-    if(skipWhiteSpaces(&fptr)) {
-        fprintf(stderr, "readPPMImage: Could not read after P6\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(skipWhiteSpaces(reader)) {
+        return headerError(reader, "readPPMImage: Could not read after P6\n");
     }
 
     // Read width
-    if(parseNumber(&fptr, &(result->width))) {
-        fprintf(stderr, "readPPMImage: Could not read width\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(parseNumber(reader, (int*)&(result->width))) {
+        return headerError(reader, "readPPMImage: Could not read width\n");
     }
 
     // Skip whitespaces after width;
-    if(skipWhiteSpaces(&fptr)) {
-        fprintf(stderr, "readPPMImage: Could not read after width\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(skipWhiteSpaces(reader)) {
+        return headerError(reader, "readPPMImage: Could not read after width\n");
     }
 
     // Read heigth
-    if(parseNumber(&fptr, &(result->heigth))) {
-        fprintf(stderr, "readPPMImage: Could not read heigth\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(parseNumber(reader, (int*)&(result->heigth))) {
+        return headerError(reader, "readPPMImage: Could not read heigth\n");
     }
 
     // Skip whitespaces after height;
-    if(skipWhiteSpaces(&fptr)) {
-        fprintf(stderr, "readPPMImage: Could not read after heigth\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(skipWhiteSpaces(reader)) {
+        return headerError(reader, "readPPMImage: Could not read after heigth\n");
     }
 
     // Read max value;
     int maxVal = 0;
-    if(parseNumber(&fptr, &maxVal)) {
-        fprintf(stderr, "readPPMImage: Could not read max value\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
+    if(parseNumber(reader, &maxVal)) {
+        return headerError(reader, "readPPMImage: Could not read max value\n");
     }
 
     // Return if max value is not 255
     if(maxVal != 255) {
         fprintf(stderr, "readPPMImage: Max value is %d (needs to be 255)\n", maxVal);
-        fclose(fptr);
         return EXIT_FAILURE;
     }
 
     // Read last whitespace character
-    if(readNextChar(&charRead, &fptr) == EXIT_SUCCESS) {
+    if(readNextChar(&charRead, reader) == EXIT_SUCCESS) {
         if (!isspace(charRead)) {
-            fprintf(stderr, "readPPMImage: Last character is not a whitespace\n");
-            fclose(fptr);
-            return EXIT_FAILURE;
+            return headerError(reader, "readPPMImage: Last character is not a whitespace\n");
         }
     }
     else {
-            fprintf(stderr, "readPPMImage: Could not read last whitespace\n");
-            fclose(fptr);
-            return EXIT_FAILURE;
+            return headerError(reader, "readPPMImage: Could not read last whitespace\n");
     }
 
-    // Allocate memory space for the content
-    result->content = malloc(result->width * result->heigth * 3);
-        if(!result->content) {
-            fprintf(stderr, "readPPMImage: Malloc failed\n");
-            fclose(fptr);
-            return EXIT_FAILURE;
-        }
+    *headerSize = reader->position;
+    return EXIT_SUCCESS;
+}
 
-    // Read data into allocated content
-    int bytesRead = fread(result->content, sizeof(char), result->width * result->heigth * 3, fptr);
+// PGM OUTPUT/WRITE
+// This writes out the PGM image stored in imageFile struct "output" with the name "outputName"
+int writePGMImage(imageFile* output, char* outputName) {
+    FILE *fptr;
+    char header[64];
+    uint64_t start = traceNow();
 
-    // In case data read is smaller than defined in the header, return
-    if(bytesRead < (result->width * result->heigth * 3)) {
-        fprintf(stderr, "readPPMImage: Content smaller than defined\n");
-        fclose(fptr);
+    fptr = fopen(outputName, "wb");
+    if(!fptr) {
+        fprintf(stderr, "writePGMImage: Could not open file\n");
         return EXIT_FAILURE;
     }
 
-    // In case data read is larger than defined in the header, return
-    if(fgetc(fptr) != EOF) {
-        fprintf(stderr, "readPPMImage: Content larger than defined\n");
-        fclose(fptr);
-        return EXIT_FAILURE;
-    }
+    // Write magic number, width height information and max value which is 255
+    int headerSize = snprintf(header, sizeof(header), "P5\n%u %u\n255\n", output->width, output->heigth);
+    size_t headerWritten = fwrite(header, sizeof(char), headerSize, fptr);
 
-    printf("readPPMImage: Data read successfull, bytes read: %d\n", bytesRead);
+    // Write content stored in output
+    size_t contentSize = (size_t)output->width * output->heigth;
+    size_t written = fwrite(output->content, sizeof(char), contentSize, fptr);
 
-    fclose(fptr);
+    if(fclose(fptr) != 0 || headerWritten != (size_t)headerSize || written != contentSize) {
+        fprintf(stderr, "writePGMImage: Could not write file\n");
+        return EXIT_FAILURE;
+    }
+    traceRecord("write", start);
     return EXIT_SUCCESS;
 }
 
-// PGM OUTPUT/WRITE
-// This writes out the PGM image stored in imageFile struct "output" with the name "outputName"
-int writePGMImage(imageFile* output, char* outputName) {
+// PPM OUTPUT/WRITE
+// This writes out the RGB image stored in imageFile struct "output" (3 bytes per pixel) as P6 with the name "outputName"
+int writePPMImage(imageFile* output, char* outputName) {
     FILE *fptr;
-    char buffer[1024];
-    char firstLine[] = "P5\n";
-    char thirdLine[] = "255\n";
+    char header[64];
+    uint64_t start = traceNow();
 
     fptr = fopen(outputName, "wb");
     if(!fptr) {
-        fprintf(stderr, "writePGMImage: Could not open file\n");
+        fprintf(stderr, "writePPMImage: Could not open file\n");
         return EXIT_FAILURE;
     }
 
-    // Write magic number
-    fwrite(firstLine, sizeof(char), strlen(firstLine) , fptr);
+    // Write magic number, width height information and max value which is 255
+    int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", output->width, output->heigth);
+    size_t headerWritten = fwrite(header, sizeof(char), headerSize, fptr);
 
-    // Write width height information
-    sprintf(buffer, "%d %d\n", output->width, output->heigth);
-    fwrite(buffer, sizeof(char) , strlen(buffer), fptr);
+    // Write content stored in output
+    size_t contentSize = (size_t)output->width * output->heigth * 3;
+    size_t written = fwrite(output->content, sizeof(char), contentSize, fptr);
 
-    // Write max value which is 255
-    fwrite(thirdLine, sizeof(char), strlen(thirdLine) , fptr);
+    if(fclose(fptr) != 0 || headerWritten != (size_t)headerSize || written != contentSize) {
+        fprintf(stderr, "writePPMImage: Could not write file\n");
+        return EXIT_FAILURE;
+    }
+    traceRecord("write", start);
+    return EXIT_SUCCESS;
+}
 
-    // Write content stored in output
-    fwrite(output->content, sizeof(char) , output->width * output->heigth, fptr);
+// PGM OUTPUT/MAP
+// Creates the PGM file "outputName" for an image of output->width x output->heigth, writes its header
+// and maps it, so output->content points to the pixels in the file and can be written directly.
+// The blocks of the file are allocated here, so a full disk fails now and not with SIGBUS on a store.
+// syncPGMImage writes the pixels to the file and checks for errors, freeImageFile unmaps it.
+int mapPGMImage(imageFile* output, char* outputName) {
+    uint64_t start = traceNow();
+    char header[64];
+    int headerSize = snprintf(header, sizeof(header), "P5\n%u %u\n255\n", output->width, output->heigth);
+    size_t fileSize = headerSize + (size_t)output->width * output->heigth;
+
+    int fd = open(outputName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1) {
+        fprintf(stderr, "mapPGMImage: Could not open file\n");
+        return EXIT_FAILURE;
+    }
+
+    // Size the file first, the mapping can not grow it (ftruncate would leave a sparse file)
+    if(posix_fallocate(fd, 0, fileSize) != 0) {
+        fprintf(stderr, "mapPGMImage: Could not allocate file\n");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    // writes to the padding after the end of the file never reach the file
+    size_t mappingSize = 0;
+    uint8_t* mapping = mapFilePadded(fd, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, &mappingSize);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        fprintf(stderr, "mapPGMImage: Could not map file\n");
+        return EXIT_FAILURE;
+    }
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+
+    memcpy(mapping, header, headerSize);
+    output->content = mapping + headerSize;
+    output->mapping = mapping;
+    output->mappingSize = mappingSize;
+    output->padding = mappingSize - fileSize;
+    traceRecord("alloc", start);
+    return EXIT_SUCCESS;
+}
 
-    fclose(fptr);
+// Writes the pixels of an image of mapPGMImage to its file, returns EXIT_FAILURE on write errors.
+// Call it before freeImageFile, munmap reports no errors.
+int syncPGMImage(imageFile* output) {
+    uint64_t start = traceNow();
+    if(msync(output->mapping, output->mappingSize - output->padding, MS_SYNC) != 0) {
+        fprintf(stderr, "syncPGMImage: Could not write file\n");
+        return EXIT_FAILURE;
+    }
+    traceRecord("write", start);
+    return EXIT_SUCCESS;
+}
+
+// IMAGE ALLOCATION
+// Allocates image->content for contentSize bytes, IMAGE_ALIGNMENT aligned and followed by at least
+// IMAGE_PADDING bytes. Images of IMAGE_HUGE_PAGE_BYTES and more are mapped on a huge page boundary
+// and ask for transparent huge pages, so a 100 MB frame needs 50 TLB entries instead of 25000.
+// freeImageFile releases it.
+int allocImageContent(imageFile* image, size_t contentSize) {
+    uint64_t start = traceNow();
+    size_t size = (contentSize + IMAGE_PADDING + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+    image->mapping = NULL;
+    image->mappingSize = 0;
+
+    if(size >= IMAGE_HUGE_PAGE_BYTES) {
+        // map one huge page more than needed and cut it to start and end on huge page boundaries
+        size_t hugeSize = (size + IMAGE_HUGE_PAGE_BYTES - 1) & ~((size_t)IMAGE_HUGE_PAGE_BYTES - 1);
+        size_t reservedSize = hugeSize + IMAGE_HUGE_PAGE_BYTES;
+        uint8_t* reserved = mmap(NULL, reservedSize, PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(reserved == MAP_FAILED) {
+            fprintf(stderr, "allocImageContent: Could not map memory\n");
+            image->content = NULL;
+            return EXIT_FAILURE;
+        }
+        uint8_t* mapping = (uint8_t*)(((uintptr_t)reserved + IMAGE_HUGE_PAGE_BYTES - 1) 
+            & ~((uintptr_t)IMAGE_HUGE_PAGE_BYTES - 1));
+        if(mapping > reserved)
+            munmap(reserved, mapping - reserved);
+        munmap(mapping + hugeSize, reserved + reservedSize - (mapping + hugeSize));
+        // only a hint, without transparent huge pages the mapping uses normal pages
+        madvise(mapping, hugeSize, MADV_HUGEPAGE);
+
+        image->content = mapping;
+        image->mapping = mapping;
+        image->mappingSize = hugeSize;
+        image->padding = hugeSize - contentSize;
+    } else {
+        if(posix_memalign((void**)&image->content, IMAGE_ALIGNMENT, size) != 0) {
+            fprintf(stderr, "allocImageContent: Malloc failed\n");
+            image->content = NULL;
+            return EXIT_FAILURE;
+        }
+        image->padding = size - contentSize;
+    }
+    traceRecord("alloc", start);
     return EXIT_SUCCESS;
 }
 
@@ -187,40 +377,41 @@ int isNewLine(char c) {
     return (c == 10) || (c == 13);
 }
 
-// Reads the next character in the file while skipping all comments starting with "#"
-int readNextChar(char *charStore, FILE **fptr) {
-    char temp[2];
-
-    while(fread(temp, sizeof(char), 1, *fptr)) {    
-        if((temp[0] == '#')) {
-            while(!isNewLine(temp[0])) {
-                if(!fread(temp, sizeof(char), 1, *fptr)) {
-                    fclose(*fptr);
+// Reads the next character in the header while skipping all comments starting with "#"
+int readNextChar(char *charStore, headerReader *reader) {
+    while(reader->position < reader->size) {
+        char charRead = reader->data[reader->position++];
+        if(charRead == '#') {
+            while(!isNewLine(charRead)) {
+                if(reader->position >= reader->size) {
+                    reader->truncated = 1;
                     return EXIT_FAILURE;
                 }
+                charRead = reader->data[reader->position++];
             }
         }
         else {
-            *charStore = temp[0];
+            *charStore = charRead;
             return EXIT_SUCCESS;
         }   
     }
 
+    reader->truncated = 1;
     return EXIT_FAILURE;
 }
 
 // Helper function: skips all connected whitespaces in the header
-int skipWhiteSpaces(FILE **fptr) {
+int skipWhiteSpaces(headerReader *reader) {
     char charRead;
 
-    if(readNextChar(&charRead, fptr) == EXIT_SUCCESS) {
+    if(readNextChar(&charRead, reader) == EXIT_SUCCESS) {
         while(isspace(charRead)) {
-            if(readNextChar(&charRead, fptr) == EXIT_FAILURE) {
-                fclose(*fptr);
+            if(readNextChar(&charRead, reader) == EXIT_FAILURE) {
                 return EXIT_FAILURE;
             }
         }
-        ungetc(charRead, *fptr);
+        // put back the first non whitespace
+        reader->position--;
         return EXIT_SUCCESS;
     }
 
@@ -228,10 +419,10 @@ int skipWhiteSpaces(FILE **fptr) {
 }
 
 // Helper function: parses a positive number in the header
-int parseNumber(FILE **fptr, int *store) {
+int parseNumber(headerReader *reader, int *store) {
     char charRead;
     int result = 0;
-    while(readNextChar(&charRead, fptr) == EXIT_SUCCESS) {  
+    while(readNextChar(&charRead, reader) == EXIT_SUCCESS) {  
         if(!isdigit(charRead) && result == 0) return EXIT_FAILURE;
         if(isdigit(charRead)) {
             if(result < (INT_MAX / 10))
@@ -241,7 +432,8 @@ int parseNumber(FILE **fptr, int *store) {
             result += charRead - '0';
         }
         else {
-            ungetc(charRead, *fptr);
+            // put back the first character after the number
+            reader->position--;
             *store = result;
             return EXIT_SUCCESS;
         }
@@ -249,8 +441,12 @@ int parseNumber(FILE **fptr, int *store) {
     return EXIT_FAILURE;
 }
 
-// Frees content if it is allocated
+// Frees or unmaps content if it is allocated
 void freeImageFile(imageFile* imageFile) {
-    if(imageFile->content != NULL)
+    uint64_t start = traceNow();
+    if(imageFile->mapping != NULL)
+        munmap(imageFile->mapping, imageFile->mappingSize);
+    else if(imageFile->content != NULL)
         free(imageFile->content);
-}
\ No newline at end of file
+    traceRecord("free", start);
+}
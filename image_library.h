@@ -1,11 +1,51 @@
+#ifndef IMAGE_LIBRARY_H
+#define IMAGE_LIBRARY_H
+
 #include <stdint.h>
+#include <stddef.h>
+
+// Content from allocImageContent starts on an IMAGE_ALIGNMENT boundary
+#define IMAGE_ALIGNMENT 64
+// Bytes after the content of a padded image that can be read and written, enough for
+// the widest kernel iteration (PLAN_VECTOR_PIXELS of RGB) to run past the last pixel
+#define IMAGE_PADDING 256
+// Allocations of at least this size are mapped and get transparent huge pages
+#define IMAGE_HUGE_PAGE_BYTES (2 << 20)
+
 // Defines a struct which holds essentials of an image file
 typedef struct imageFile {
   unsigned int width;
   unsigned int heigth;
   uint8_t* content;
+  // set if content points into a mapping (readPPMImage, mapPGMImage, large allocImageContent),
+  // NULL if content is malloced
+  uint8_t* mapping;
+  size_t mappingSize;
+  // bytes after the content that can be read and written (their values are undefined),
+  // at least IMAGE_PADDING for images of readPPMImage, mapPGMImage and allocImageContent, 0 if unknown
+  // (images of readPPMImage are read-only until makeImageWritable)
+  size_t padding;
 }imageFile;
 
+// Position in a header that is parsed from memory
+typedef struct headerReader {
+  uint8_t* data;
+  size_t size;
+  size_t position;
+  // set if more data can follow after size (a pipe), running out is then not reported as an error
+  int partial;
+  // set by the parser if it ran out of data
+  int truncated;
+}headerReader;
+
 int readPPMImage(imageFile* imageFile, char* imageName);
+int parsePPMHeader(imageFile* result, headerReader* reader, size_t* headerSize);
+int makeImageWritable(imageFile* image);
 int writePGMImage(imageFile* imageName, char* outputName);
-void freeImageFile(imageFile* imageFile);
\ No newline at end of file
+int writePPMImage(imageFile* output, char* outputName);
+int mapPGMImage(imageFile* output, char* outputName);
+int syncPGMImage(imageFile* output);
+int allocImageContent(imageFile* image, size_t contentSize);
+void freeImageFile(imageFile* imageFile);
+
+#endif
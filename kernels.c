@@ -0,0 +1,137 @@
+/*
+    This file includes the registry of all implementations and the CPU feature detection used to pick one.
+    Header file kernels.h defines the CPU feature flags and the registry.
+*/
+
+#include "kernels.h"
+#include <cpuid.h>
+
+// maxError and meanError are the --verify tolerances (largest and mean error against the exact result).
+// Every implementation is at most 1 off, the Taylor series ones since ln and e^x are range reduced.
+// Hash implementations truncate the grayscale value to a key, so for small gammas a dark pixel
+// can be far off the exact result (gamma 0.1: grayscale 0.99 gives key 0 and 0, the exact result is 146).
+// keyError is how far off their key can be: the asm keys (also used by AVX2 and AVX-512) truncate
+// every product, so they are up to 2 below, the C keys truncate the float sum.
+// --verify only counts their error outside of the results of those keys for maxError.
+// streamingHashFunction is the optional streaming version of the table function (non-temporal stores),
+// asm_hash_simd gets the 16 pixel one: byte stores can not bypass the cache and the keys are the same.
+gammaKernel kernelRegistry[] = {
+    {.name = "gamma_correct_asm_hash_simd", .function = &gamma_correct_asm_hash_simd,
+        .buildHash = &gamma_correct_asm_build_hash_simd, .hashFunction = &gamma_correct_asm_hash_table,
+        .streamingHashFunction = &gamma_correct_asm_hash_simd16_table_nt,
+        .keyError = 2,
+        .requiredFeatures = CPU_SSE3 | CPU_SSSE3, .maxError = 1.01, .meanError = 1.2},
+    {.name = "gamma_correct_c_hash_SSE", .function = &gamma_correct_c_hash_SSE,
+        .buildHash = &gamma_correct_c_build_hash_SSE, .hashFunction = &gamma_correct_c_hash_table,
+        .keyError = 1,
+        .requiredFeatures = CPU_SSE2, .maxError = 1.01, .meanError = 1.05},
+    {.name = "gamma_correct_asm_simd", .function = &gamma_correct_asm_simd,
+        .requiredFeatures = CPU_SSE3 | CPU_SSSE3, .maxError = 1.01, .meanError = 0.65},
+    {.name = "gamma_correct_c_SSE", .function = &gamma_correct_c_SSE,
+        .requiredFeatures = CPU_SSE2, .maxError = 1.01, .meanError = 0.85},
+    {.name = "gamma_correct_asm", .function = &gamma_correct_asm,
+        .requiredFeatures = CPU_SSE2, .maxError = 1.01, .meanError = 0.65},
+    {.name = "gamma_correct_c", .function = &gamma_correct_c,
+        .requiredFeatures = 0, .maxError = 1.01, .meanError = 0.85},
+    {.name = "gamma_correct_asm_hash", .function = &gamma_correct_asm_hash,
+        .buildHash = &gamma_correct_asm_build_hash, .hashFunction = &gamma_correct_asm_hash_table,
+        .keyError = 2,
+        .requiredFeatures = CPU_SSE2, .maxError = 1.01, .meanError = 1.2},
+    {.name = "gamma_correct_c_hash", .function = &gamma_correct_c_hash,
+        .buildHash = &gamma_correct_c_build_hash, .hashFunction = &gamma_correct_c_hash_table,
+        .keyError = 1,
+        .requiredFeatures = 0, .maxError = 1.01, .meanError = 1.05},
+    {.name = "gamma_correct_c_naiv", .function = &gamma_correct_c_naiv,
+        .requiredFeatures = 0, .maxError = 1.01, .meanError = 0.5},
+    {.name = "gamma_correct_asm_hash_simd16", .function = &gamma_correct_asm_hash_simd16,
+        .buildHash = &gamma_correct_asm_build_hash_simd, .hashFunction = &gamma_correct_asm_hash_simd16_table,
+        .streamingHashFunction = &gamma_correct_asm_hash_simd16_table_nt,
+        .keyError = 2,
+        .requiredFeatures = CPU_SSE3 | CPU_SSSE3, .maxError = 1.01, .meanError = 1.2},
+    {.name = "gamma_correct_c_hash_AVX2", .function = &gamma_correct_c_hash_AVX2,
+        .buildHash = &gamma_correct_asm_build_hash_simd, .hashFunction = &gamma_correct_c_hash_AVX2_table,
+        .keyError = 2,
+        .requiredFeatures = CPU_SSE3 | CPU_AVX2, .maxError = 1.01, .meanError = 1.2},
+    {.name = "gamma_correct_c_hash_AVX512", .function = &gamma_correct_c_hash_AVX512,
+        .buildHash = &gamma_correct_asm_build_hash_simd, .hashFunction = &gamma_correct_c_hash_AVX512_table,
+        .keyError = 2,
+        .requiredFeatures = CPU_SSE3 | CPU_AVX512BW, .maxError = 1.01, .meanError = 1.2},
+    {.name = "gamma_correct_c_hash_fixed", .function = &gamma_correct_c_hash_fixed,
+        .buildHash = &gamma_correct_c_build_hash, .hashFunction = &gamma_correct_c_hash_fixed_table,
+        .keyError = 1,
+        .requiredFeatures = 0, .maxError = 1.01, .meanError = 1.1},
+    {.name = "gamma_correct_c_hash_fixed_SSE", .function = &gamma_correct_c_hash_fixed_SSE,
+        .buildHash = &gamma_correct_c_build_hash, .hashFunction = &gamma_correct_c_hash_fixed_SSE_table,
+        .keyError = 1,
+        .requiredFeatures = CPU_SSSE3, .maxError = 1.01, .meanError = 1.1},
+    {.name = "gamma_correct_c_hash_fixed_AVX2", .function = &gamma_correct_c_hash_fixed_AVX2,
+        .buildHash = &gamma_correct_c_build_hash, .hashFunction = &gamma_correct_c_hash_fixed_AVX2_table,
+        .keyError = 1,
+        .requiredFeatures = CPU_AVX2, .maxError = 1.01, .meanError = 1.1},
+    {.name = "gamma_correct_c_fastpow", .function = &gamma_correct_c_fastpow,
+        .requiredFeatures = 0, .maxError = 1.01, .meanError = 0.5},
+    {.name = "gamma_correct_c_fastpow_SSE", .function = &gamma_correct_c_fastpow_SSE,
+        .requiredFeatures = CPU_SSSE3, .maxError = 1.01, .meanError = 0.5},
+    {.name = "gamma_correct_c_fastpow_AVX2", .function = &gamma_correct_c_fastpow_AVX2,
+        .requiredFeatures = CPU_AVX2, .maxError = 1.01, .meanError = 0.5},
+};
+const int kernelCount = sizeof(kernelRegistry) / sizeof(kernelRegistry[0]);
+
+// Implementations used when -V is not set, widest first
+// they all use the asm keys and give the same results (kernelTailTestCase), the last one only needs SSE2
+// (the fixed point ones are not in here, their keys can be 1 off)
+const int defaultOrder[] = {KERNEL_C_HASH_AVX512, KERNEL_C_HASH_AVX2,
+    KERNEL_ASM_HASH_SIMD16, KERNEL_ASM_HASH_SIMD, KERNEL_ASM_HASH};
+const int defaultOrderCount = sizeof(defaultOrder) / sizeof(defaultOrder[0]);
+
+// Reads the CPU features with cpuid, only checked once
+int getCpuFeatures() {
+    static int features = -1;
+    unsigned int eax, ebx, ecx, edx;
+
+    if(features != -1)
+        return features;
+    features = 0;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return features;
+    if(edx & bit_SSE2)
+        features |= CPU_SSE2;
+    if(ecx & bit_SSE3)
+        features |= CPU_SSE3;
+    if(ecx & bit_SSSE3)
+        features |= CPU_SSSE3;
+
+    // the OS has to save the ymm/zmm registers, otherwise AVX can not be used (XCR0)
+    unsigned int xcr0 = 0;
+    if(ecx & bit_OSXSAVE) {
+        unsigned int xcr0High;
+        __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+    }
+
+    if(__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        // xmm and ymm state
+        if((ebx & bit_AVX2) && (xcr0 & 0x06) == 0x06)
+            features |= CPU_AVX2;
+        // xmm, ymm, opmask and zmm state
+        if((ebx & bit_AVX512F) && (ebx & bit_AVX512BW) && (xcr0 & 0xE6) == 0xE6)
+            features |= CPU_AVX512BW;
+        if((features & CPU_AVX512BW) && (ecx & bit_AVX512VBMI))
+            features |= CPU_AVX512VBMI;
+    }
+    return features;
+}
+
+// Returns 1 if the CPU has all features the implementation needs
+int isKernelSupported(gammaKernel* kernel) {
+    return (kernel->requiredFeatures & getCpuFeatures()) == kernel->requiredFeatures;
+}
+
+// Returns the index of the widest implementation this CPU supports
+int getDefaultKernel() {
+    for(int i = 0; i < defaultOrderCount; i++) {
+        if(isKernelSupported(&kernelRegistry[defaultOrder[i]]))
+            return defaultOrder[i];
+    }
+    return KERNEL_C_HASH;
+}
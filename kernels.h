@@ -0,0 +1,47 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "gamma_correct.h"
+
+// CPU features an implementation can depend on
+#define CPU_SSE2 1
+#define CPU_SSE3 2
+#define CPU_SSSE3 4
+#define CPU_AVX2 8
+#define CPU_AVX512BW 16 // AVX-512F and AVX-512BW
+#define CPU_AVX512VBMI 32 // AVX-512VBMI (vpermb), only set together with CPU_AVX512BW
+
+// Index of every implementation in the registry, this is the number used with -V
+enum {
+  KERNEL_ASM_HASH_SIMD,
+  KERNEL_C_HASH_SSE,
+  KERNEL_ASM_SIMD,
+  KERNEL_C_SSE,
+  KERNEL_ASM,
+  KERNEL_C,
+  KERNEL_ASM_HASH,
+  KERNEL_C_HASH,
+  KERNEL_C_NAIV,
+  KERNEL_ASM_HASH_SIMD16,
+  KERNEL_C_HASH_AVX2,
+  KERNEL_C_HASH_AVX512,
+  KERNEL_C_HASH_FIXED,
+  KERNEL_C_HASH_FIXED_SSE,
+  KERNEL_C_HASH_FIXED_AVX2,
+  KERNEL_C_FASTPOW,
+  KERNEL_C_FASTPOW_SSE,
+  KERNEL_C_FASTPOW_AVX2
+};
+
+// All implementations
+extern gammaKernel kernelRegistry[];
+extern const int kernelCount;
+// Implementations getDefaultKernel picks from, widest first
+extern const int defaultOrder[];
+extern const int defaultOrderCount;
+
+int getCpuFeatures();
+int isKernelSupported(gammaKernel* kernel);
+int getDefaultKernel();
+
+#endif
@@ -5,34 +5,89 @@
 #include "gamma_correct.h"
 #include "image_library.h"
 #include "test.h"
+#include "parallel.h"
+#include "kernels.h"
+#include "stream.h"
+#include "batch.h"
+#include "plan.h"
+#include "bench.h"
+#include "generate.h"
+#include "trace.h"
+#include "verify.h"
+#include "rgb_cache.h"
+#include "point_ops.h"
+#include "frames.h"
+#include <unistd.h>
 #include <getopt.h>
 #include <time.h>
 #include <math.h>
 
-double gamma_correct_generic(int iterations, void (*function)(uint8_t*, 
-    int, int, float, float, float, float, uint8_t*), 
-    uint8_t* inputContent, int width, int height, float a, float b, float c, float gamma, 
-    uint8_t* outputContent);
+double gamma_correct_generic(int iterations, gammaPlan* plan, 
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded);
+double gamma_correct_parallel_generic(int iterations, threadPool* pool, gammaPlan* plan, 
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded);
+int gamma_correct_multi_files(imageFile* input, char* outputfile, int implementation, 
+    float a, float b, float c, float* gammas, int gammaCount, pointOpChain* pointOps, 
+    char* rgbCache, int threads, int benchmarking, int measureTime);
+int gamma_correct_color_file(imageFile* input, char* outputfile, float* gammas, int gammaCount, 
+    pointOpChain* pointOps, int threads, int benchmarking, int measureTime, int inPlace);
 
 /**
  * Print a helpful bit of text for the user. Helper Method to main()
 */
 void print_help() {
     printf("-----[Help Desk]-----\n\n[OPTIONS:]\n \n");
-    printf("-V <int> what implementation to use. If this is not set, will run implementation 0.\n");
-    printf("Implementations are :\n0 = asm_hash_simd\n1 = c_hash_sse\n2 = asm_simd\n3 = c_sse\n4 = asm_basic\n5 = c_basic\n6 = c_hash\n7 = asm_hash\n8 = c_library\n\n");
+    printf("-V <int> what implementation to use. If this is not set, will run the widest implementation this CPU supports (%d).\n", getDefaultKernel());
+    printf("Implementations are :\n");
+    for (int i = 0; i < kernelCount; i++) {
+        printf("%d = %s%s\n", i, kernelRegistry[i].name, isKernelSupported(&kernelRegistry[i]) ? "" : " (not supported by this CPU)");
+    }
+    printf("\n");
     printf("-B measure execution time. a value > 0 will result in the program running multiple times.\n\n");
+    printf("-j <int> run the implementation in row bands on <int> threads. 0 uses all cores. Together with -B the time is measured for 1, 2, 4, ... up to <int> threads.\n\n");
     printf("<string> path for the input file. If this is not given, the program terminates. Make sure not to have multiple of these.\n \n");
     printf("-o <string> path for the output file. This has to be a .pgm file. This is a required option.\n \n");
+    printf("-m / --mmap-output map the output file and let the implementation write directly into it instead of writing a separate buffer at the end.\n \n");
+    printf("--in-place write the output over the input instead of into a separate buffer (25%% less memory for grayscale, half for --color). Works with every implementation, -j, --stream and --color. Not with -B <n> or -B and -j (later runs would convert the output of the first), --batch, --bench, -m or a --gamma list.\n \n");
+    printf("-s / --stream convert the image in chunks of rows while reading and writing in the background. Needs only a few MB of memory for any image size. -B only measures one run.\n \n");
+    printf("--frames convert a stream of P6 frames (e.g. from ffmpeg -f image2pipe -vcodec ppm) on stdin to P5 frames on stdout. The next frame is read and the last one written while one is converted, the table, buffers and threads are reused for all frames. Needs no input file or -o, messages go to stderr, the frames/sec are printed at the end. Not with --color, --stream, --batch, --bench, -m, --in-place or a --gamma list.\n \n");
+    printf("--incremental with --frames or --batch: keep the last frame and only convert the tiles of %dx%d pixels that changed since then, the others are copied from the last output. Prints how many tiles were reprocessed for every frame. --batch then converts the files in name (or list) order, the threads share the tiles of every file.\n \n", TILE_WIDTH, TILE_HEIGHT);
+    printf("--batch <string> convert all .ppm files of a directory or all files listed (one per line) in a text file. -o is the output directory then, every file is written as <name without .ppm>.pgm into it (two inputs with the same name in different directories are an error). Files are converted in parallel on -j threads (default all cores).\n \n");
+    printf("--bench compare implementations: warmup, then median, p5/p95, stddev, Mpixel/s, GB/s, DRAM GB/s (last level cache misses * 64 bytes with --perf, otherwise marked ~ and estimated as GB/s plus the read for ownership of the output without non-temporal stores) and cycles/pixel of every sample. Implementations with a streaming version (non-temporal stores, used automatically for images larger than twice the last level cache) also run with it (+nt). Runs all implementations this CPU supports (or -V) on generated images from L1 to DRAM size (or --size, or the input file). -B sets the number of samples, -j the threads.\n \n");
+    printf("--json <string> write the --bench results to this JSON file.\n \n");
+    printf("--perf read hardware counters (cycles, instructions, IPC, L1/LLC misses, branch misses, frontend/backend stalls, page faults) around the --bench samples. Counts only the calling thread, so not with -j. Missing counters are shown as - / null.\n \n");
+    printf("--generate <string> write a synthetic image of --size to -o (a .ppm file) and exit, or use this pattern for --bench. Patterns are random, gradient, flat and photo. No --gamma needed.\n \n");
+    printf("--size <uint>x<uint> width and height for --generate (default 1920x1080) and --bench.\n \n");
+    printf("--seed <uint> seed for --generate, the same seed gives the same image (default 1).\n \n");
+    printf("--trace <string> time every stage (open, parse, read, alloc, table, kernel/band, write, free), print a summary and write a Chrome trace (chrome://tracing, Perfetto) to this file.\n \n");
     printf("--coeffs <float>,<float>,<float> used for gray scaling weights (a, b, c). Uses 0.3f, 0.59f, 0.11f as default. All must be > 0.\n \n");
-    printf("--gamma <float> the gamma used for gamma correction. \nMust be > 0, else the default is used.\nThis a required option.\n \n");
+    printf("--gamma <float> the gamma used for gamma correction. \nMust be > 0, else the default is used.\nThis a required option.\n");
+    printf("A list <float>,<float>,... (up to %d) converts the input for all gammas in one pass and writes one file per gamma (output_<gamma>.pgm). Not with --stream, --batch, --bench or -m.\n \n", MAX_GAMMAS);
+    printf("--rgb-cache <string> look up every pixel in a 16 MiB table of all RGB triples (same results as the implementation). The table is built on all cores on first use, saved in this directory and mapped by later runs with the same implementation, --coeffs and --gamma. Fastest on images with few colors. --bench then also measures every implementation with its table.\n \n");
+    printf("--ops <op>,<op>,... point operations applied in order after the gamma correction: gamma=<float>, levels=<black>:<white>[:<output black>:<output white>], invert, threshold=<t>, brightness=<-255..255>, contrast=<factor>, curve=<name> (see --curve). They are folded into the hash table, so any number of them costs the same as gamma alone. Needs an implementation with a hash table. --gamma is optional then. Not with --bench.\n \n");
+    printf("--color gamma correct every channel on its own and write a color .ppm file (-o) instead of grayscale. --gamma takes 1 or 3 values (red, green, blue), --ops are applied to every channel, -V and --coeffs are not used. Not with --stream, --batch, --bench, -m or --rgb-cache.\n \n");
+    printf("--curve <string> apply a standard transfer curve after the gamma correction (or instead of it without --gamma): srgb / linear-to-srgb, srgb-to-linear, rec709 / linear-to-rec709, rec709-to-linear, pq / linear-to-pq, pq-to-linear (SMPTE ST 2084, 255 = 10000 cd/m2). It is an operation of --ops (in command line order), so it costs the same as gamma alone.\n \n");
+    printf("--verify compare all implementations this CPU supports (or -V, set it before --verify) with a double precision pow reference on %s and generated images for several gammas and coefficients. Fails if one is outside of its tolerance.\n \n", VERIFY_INPUT_DIRECTORY);
     printf("-h / --help open the Help Desk.\n \n");
     printf("[USAGE:]\n");
-    printf("./main.out -V [0,8] -B [uint] input.ppm -o output.pgm --coeffs [float],[float],[float] --gamma [0, inf)\n");
+    printf("./main.out -V [0,17] -B [uint] -j [uint] input.ppm -o output.pgm --coeffs [float],[float],[float] --gamma [0, inf)\n");
     printf("[EXAMPLE USAGE:]\n");
     printf("./main.out -V0 -B10 input.ppm -o output.pgm --coeffs 0.3,0.59,0.11 --gamma 2.5\n");
 }
 
+/*
+ * Prints the stage summary and writes the Chrome trace if --trace was set. Helper Method to main()
+*/
+void finish_trace(char* traceName) {
+    if (traceName == NULL) {
+        return;
+    }
+    printTraceSummary();
+    if (writeChromeTrace(traceName) != EXIT_SUCCESS) {
+        exit(EXIT_FAILURE);
+    }
+}
+
 void exit_help() {
     printf("\nUse ./main -h|--help for usage.\n\n");
     exit(EXIT_FAILURE);
@@ -66,15 +121,37 @@ bool is_string_float(char* string) {
 
 int main(int argc, char *argv[]) {
 
-    int implementation = 0; //what implementation is used?
+    int implementation = -1; //what implementation is used? -1 = widest the CPU supports
     int benchmarking = 0; // is time measured?
     int measureTime = 1; // if so, how many times will the code run?
+    int threads = 0; // how many threads run the implementation? 0 = no thread pool
+    int mapOutput = 0; // does the implementation write directly into the mapped output file?
+    int inPlace = 0; // is the output written over the input?
+    int stream = 0; // is the image converted in chunks without holding it in memory?
+    int frames = 0; // are frames converted from stdin to stdout?
+    int incremental = 0; // do --frames and --batch only convert the tiles that changed?
+    char* batchList = NULL; // directory or list file of inputs for the batch mode
+    int bench = 0; // are implementations compared with --bench?
+    int perf = 0; // are hardware counters read during --bench?
+    char* traceName = NULL; // file for the Chrome trace of all stages
+    char* jsonName = NULL; // file for the --bench results
+    char* rgbCache = NULL; // directory of the RGB tables, NULL = compute every pixel
+    int color = 0; // is every channel corrected on its own (RGB output) instead of grayscale?
+    int generate = 0; // is a synthetic image written (or used by --bench)?
+    imagePattern pattern = PATTERN_RANDOM;
+    size_t generateWidth = 0; // 0 = default size
+    size_t generateHeight = 0;
+    uint32_t seed = 1;
     char* filename = NULL;
     char* outputfile = NULL;
     float a = 0.3f;
     float b = 0.59f;
     float c = 0.11f;
     float gamma = NAN;
+    float gammas[MAX_GAMMAS]; // all values of --gamma, gamma is the first one
+    int gammaCount = 0;
+    pointOpChain opChain = {0};
+    pointOpChain* pointOps = NULL; // --ops and --curve, NULL = only gamma correction
 
     int opt; //this stores the option you actually get ('g', 'c', 'B' etc.)
     static struct option options_long[] = {
@@ -82,19 +159,41 @@ int main(int argc, char *argv[]) {
         {"coeffs", required_argument, 0, 'c'},
         {"help", no_argument, 0, 'h'}, //double mapping --help to -h
         {"test", no_argument, 0, 't'},
+        {"mmap-output", no_argument, 0, 'm'},
+        {"in-place", no_argument, 0, 'I'},
+        {"stream", no_argument, 0, 's'},
+        {"frames", no_argument, 0, 'F'},
+        {"incremental", no_argument, 0, 'i'},
+        {"batch", required_argument, 0, 'b'},
+        {"bench", no_argument, 0, 'n'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", required_argument, 0, 'T'},
+        {"verify", no_argument, 0, 'y'},
+        {"rgb-cache", required_argument, 0, 'R'},
+        {"ops", required_argument, 0, 'O'},
+        {"color", no_argument, 0, 'C'},
+        {"curve", required_argument, 0, 'u'},
+        {"json", required_argument, 0, 'J'},
+        {"generate", required_argument, 0, 'G'},
+        {"size", required_argument, 0, 'S'},
+        {"seed", required_argument, 0, 'e'},
         {0, 0, 0, 0}
     };
 
     // parses options and checks vor validity
-    while ((opt = getopt_long(argc, argv, "-V:B::tho:g:c:", options_long, NULL)) != -1)
+    while ((opt = getopt_long(argc, argv, "-V:B::j:mstho:g:c:", options_long, NULL)) != -1)
     {
         switch (opt) {
             case 'V':
                 implementation = atoi(optarg);
-                if(implementation > 8 || implementation < 0 || !is_string_number(optarg)) {
-                    fprintf(stderr, "Invalid -V %s. Can only be 0, 1, 2, 3, 4, 5, 6, 7, 8 or unset option. Exiting.\n", optarg);
+                if(implementation >= kernelCount || implementation < 0 || !is_string_number(optarg)) {
+                    fprintf(stderr, "Invalid -V %s. Can only be 0 to %d or unset option. Exiting.\n", optarg, kernelCount - 1);
                     exit_help();
                 }
+                if(!isKernelSupported(&kernelRegistry[implementation])) {
+                    fprintf(stderr, "Invalid -V %s. %s is not supported by this CPU. Exiting.\n", optarg, kernelRegistry[implementation].name);
+                    exit(EXIT_FAILURE);
+                }
                 break;
             case 'B':
                 benchmarking = 1;
@@ -114,9 +213,100 @@ int main(int argc, char *argv[]) {
                 }
                 measureTime += measureTimeTemp;
                 break;
+            case 'j':
+                threads = atoi(optarg);
+                if (!is_string_number(optarg) || threads < 0) {
+                    fprintf(stderr, "Invalid -j %s. Has to be a positiv number or 0. Exiting.\n", optarg);
+                    exit_help();
+                }
+                if (threads == 0) {
+                    threads = sysconf(_SC_NPROCESSORS_ONLN);
+                }
+                break;
             case 'o':
                 outputfile = optarg;
                 break;
+            case 'm':
+                mapOutput = 1;
+                break;
+            case 'I':
+                inPlace = 1;
+                break;
+            case 's':
+                stream = 1;
+                break;
+            case 'F':
+                frames = 1;
+                break;
+            case 'i':
+                incremental = 1;
+                break;
+            case 'b':
+                batchList = optarg;
+                break;
+            case 'n':
+                bench = 1;
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                traceName = optarg;
+                traceEnable();
+                break;
+            case 'J':
+                jsonName = optarg;
+                break;
+            case 'R':
+                rgbCache = optarg;
+                break;
+            case 'C':
+                color = 1;
+                break;
+            case 'u':
+                char curveOp[64];
+                snprintf(curveOp, sizeof(curveOp), "curve=%s", optarg);
+                if (appendPointOps(curveOp, &opChain) != EXIT_SUCCESS) {
+                    fprintf(stderr, "Invalid --curve %s. Has to be srgb, rec709, pq, linear-to-srgb, srgb-to-linear, linear-to-rec709, rec709-to-linear, linear-to-pq or pq-to-linear. Exiting\n", optarg);
+                    exit_help();
+                }
+                pointOps = &opChain;
+                break;
+            case 'O':
+                if (appendPointOps(optarg, &opChain) != EXIT_SUCCESS) {
+                    fprintf(stderr, "Invalid --ops %s. Exiting\n", optarg);
+                    exit_help();
+                }
+                pointOps = &opChain;
+                break;
+            case 'G':
+                generate = 1;
+                if (parsePattern(optarg, &pattern) != EXIT_SUCCESS) {
+                    fprintf(stderr, "Invalid --generate %s. Has to be random, gradient, flat or photo. Exiting.\n", optarg);
+                    exit_help();
+                }
+                break;
+            case 'S':
+                char* separator = strchr(optarg, 'x');
+                if (separator == NULL) {
+                    fprintf(stderr, "Invalid --size %s. Has to be <width>x<height>. Exiting.\n", optarg);
+                    exit_help();
+                }
+                *separator = '\0';
+                generateWidth = strtoull(optarg, NULL, 10);
+                generateHeight = strtoull(separator + 1, NULL, 10);
+                if (!is_string_number(optarg) || !is_string_number(separator + 1) || generateWidth == 0 || generateHeight == 0) {
+                    fprintf(stderr, "Invalid --size. Has to be <width>x<height> with positiv numbers. Exiting.\n");
+                    exit_help();
+                }
+                break;
+            case 'e':
+                seed = strtoul(optarg, NULL, 10);
+                if (!is_string_number(optarg)) {
+                    fprintf(stderr, "Invalid --seed %s. Has to be a positiv number. Exiting.\n", optarg);
+                    exit_help();
+                }
+                break;
             case 'c':
                 float abc[] = {a, b, c};
                 const char comma[2] = ",";
@@ -141,17 +331,25 @@ int main(int argc, char *argv[]) {
                 c = abc[2];
                 break;
             case 'g':
-                if(is_string_float(optarg)) {
-                    gamma = atof(optarg);
-                } else {
-                    fprintf(stderr, "Invalid --gamma %s. Has to be one not-negativ float. Exiting\n", optarg);
-                    exit_help();
+                gammaCount = 0;
+                char* gammaToken = strtok(optarg, ",");
+                while (gammaToken != NULL) {
+                    if (!is_string_float(gammaToken) || gammaCount == MAX_GAMMAS) {
+                        fprintf(stderr, "Invalid --gamma %s. Has to be up to %d not-negativ floats separated by commas. Exiting\n", gammaToken, MAX_GAMMAS);
+                        exit_help();
+                    }
+                    gammas[gammaCount++] = atof(gammaToken);
+                    gammaToken = strtok(NULL, ",");
                 }
+                gamma = gammaCount > 0 ? gammas[0] : NAN;
                 break;
             case 't':
                 test();
                 exit(EXIT_SUCCESS);
                 break;
+            case 'y':
+                exit(gamma_correct_verify(implementation));
+                break;
             case 'h':
                 print_help();
                 exit(EXIT_SUCCESS);
@@ -178,24 +376,113 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // check for valid gamma
-    if(isnan(gamma) || gamma < 0) {
+    // stdout carries the frames, so all messages go to stderr
+    int framesOutput = -1;
+    if (frames) {
+        framesOutput = dup(STDOUT_FILENO);
+        if (framesOutput == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+            fprintf(stderr, "Could not redirect stdout for --frames. Exiting\n");
+            exit(EXIT_FAILURE);
+        }
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    }
+
+    // write a synthetic image instead of converting one
+    if (generate && !bench) {
+        if (outputfile == NULL || strlen(outputfile) <= 4 || strcmp(outputfile + strlen(outputfile)-4, ".ppm")) {
+            fprintf(stderr, "--generate needs an output file name ending with .ppm (-o). Quitting.\n");
+            exit_help();
+        }
+        if (generateWidth == 0) {
+            generateWidth = 1920;
+            generateHeight = 1080;
+        }
+        if (writeGeneratedPPMImage(outputfile, generateWidth, generateHeight, pattern, seed) != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Generated %zux%zu %s image (seed %u) in %s\n", generateWidth, generateHeight, patternName(pattern), seed, outputfile);
+        exit(EXIT_SUCCESS);
+    }
+
+    // check for valid gamma (--ops alone needs none)
+    if((isnan(gamma) && (pointOps == NULL || bench)) || gamma < 0) {
         fprintf(stderr, "Invalid or unset --gamma. Has to be number in [0, inf). Exiting\n");
         exit_help();
     }
-    printf("INFO: Gamma is %f\n", gamma);
+    if (color && (stream || batchList != NULL || bench || mapOutput || rgbCache != NULL || (gammaCount != 0 && gammaCount != 1 && gammaCount != 3))) {
+        fprintf(stderr, "--color needs 1 or 3 gammas and can not be used with --stream, --batch, --bench, -m or --rgb-cache. Exiting\n");
+        exit_help();
+    }
+    if (gammaCount > 1) {
+        if (stream || batchList != NULL || bench || mapOutput) {
+            fprintf(stderr, "A --gamma list can not be used with --stream, --batch, --bench or -m. Exiting\n");
+            exit_help();
+        }
+        printf("INFO: Gammas are");
+        for (int k = 0; k < gammaCount; k++) {
+            printf(" %f", gammas[k]);
+        }
+        printf("\n");
+    } else if (!isnan(gamma)) {
+        printf("INFO: Gamma is %f\n", gamma);
+    }
+    // the 3 gammas of --color are one per channel, not a list
+    if (inPlace && (measureTime > 1 || (benchmarking && threads > 0) || batchList != NULL || bench || mapOutput || (!color && gammaCount > 1))) {
+        fprintf(stderr, "--in-place can not be used with -B <n>, -B and -j, --batch, --bench, -m or a --gamma list. Exiting\n");
+        exit_help();
+    }
+    if (frames && (color || stream || batchList != NULL || bench || mapOutput || inPlace || gammaCount > 1)) {
+        fprintf(stderr, "--frames can not be used with --color, --stream, --batch, --bench, -m, --in-place or a --gamma list. Exiting\n");
+        exit_help();
+    }
+    if (perf && threads > 0) {
+        fprintf(stderr, "--perf can not be used with -j, the counters only count the calling thread. Exiting\n");
+        exit_help();
+    }
+    if (incremental && !frames && batchList == NULL) {
+        fprintf(stderr, "--incremental needs --frames or --batch. Exiting\n");
+        exit_help();
+    }
+    if (pointOps != NULL && bench) {
+        fprintf(stderr, "--ops can not be used with --bench. Exiting\n");
+        exit_help();
+    }
 
     // check for valid input filename ending
-    if (filename == NULL || strlen(filename) <= 4 || strcmp(filename + strlen(filename)-4, ".ppm")) {
+    if (frames) {
+        if (filename != NULL || outputfile != NULL) {
+            fprintf(stderr, "--frames reads stdin and writes stdout, it needs no input file and no -o. Quitting.\n");
+            exit_help();
+        }
+    } else if (bench) {
+        if (filename != NULL && (strlen(filename) <= 4 || strcmp(filename + strlen(filename)-4, ".ppm"))) {
+            fprintf(stderr, "Incorrect input file name or formatting. Quitting.\n");
+            exit_help();
+        }
+    } else if (batchList != NULL) {
+        if (filename != NULL || outputfile == NULL) {
+            fprintf(stderr, "--batch needs an output directory (-o) and no input file. Quitting.\n");
+            exit_help();
+        }
+    } else if (filename == NULL || strlen(filename) <= 4 || strcmp(filename + strlen(filename)-4, ".ppm")) {
         fprintf(stderr, "No input file name was given/incorrect input file name or formatting. Quitting.\n");
         exit_help();
     }
-    // check for valid output filename ending
-    if (outputfile == NULL || strlen(outputfile) <= 4 || strcmp(outputfile + strlen(outputfile)-4, ".pgm")) {
+    // check for valid output filename ending (color images are .ppm)
+    else if (outputfile == NULL || strlen(outputfile) <= 4 || strcmp(outputfile + strlen(outputfile)-4, color ? ".ppm" : ".pgm")) {
         fprintf(stderr, "No output file name was given/incorrect output file name or formatting. Quitting.\n");
         exit_help();
     }
 
+    int allImplementations = implementation == -1; // --bench runs all of them then
+    if (implementation == -1) {
+        implementation = getDefaultKernel();
+    }
+    if (pointOps != NULL && !color && kernelRegistry[implementation].buildHash == NULL) {
+        fprintf(stderr, "--ops needs an implementation with a hash table, %s has none. Exiting\n", kernelRegistry[implementation].name);
+        exit_help();
+    }
+
     // normalize coeffs
     float abc = a + b + c;
     a = a/abc;
@@ -203,120 +490,404 @@ int main(int argc, char *argv[]) {
     c = c/abc;
     printf("INFO: Normalized coeffs to %f, %f, %f\n", a, b, c);
     printf("INFO: Measuring %d times\n", measureTime);
-    printf("INFO: Output file is %s\n", outputfile);
-    printf("INFO: Input file is %s\n", filename);
+    printf("INFO: Output file is %s\n", frames ? "stdout" : outputfile);
+    printf("INFO: Input file is %s\n", frames ? "stdin" : batchList != NULL ? batchList : filename);
     printf("INFO: Using implementation %d\n", implementation);
+    if (threads > 0) {
+        printf("INFO: Using %d threads\n", threads);
+    }
 
     printf("\n");
 
+    // compare implementations and sizes, every implementation gets its own plan
+    if (bench) {
+        threadPool* pool = NULL;
+        if (threads > 0 && (pool = createThreadPool(threads)) == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        int result = gamma_correct_bench(filename, allImplementations ? -1 : implementation, pool,
+            benchmarking ? measureTime : BENCH_SAMPLES, a, b, c, gamma, jsonName,
+            pattern, seed, generateWidth, generateHeight, perf, rgbCache);
+        freeThreadPool(pool);
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
+
+    // select implementation, the plan builds the hash table once for all runs
+    gammaPlan plan;
+    uint64_t start = traceNow();
+    initGammaPlanWithOps(&plan, &kernelRegistry[implementation], a, b, c, gamma, pointOps);
+    traceRecord("table", start);
+    if (rgbCache != NULL && gammaCount <= 1 && attachRGBTable(&plan, rgbCache, NULL) != EXIT_SUCCESS) {
+        exit(EXIT_FAILURE);
+    }
+    if (!color) {
+        printf("Using %s\n", plan.kernel->name);
+    }
+    if (implementation == KERNEL_C_NAIV && !color) {
+        printf("This uses powf(float, float) from math.h for gamma corection\n");
+    }
+
+    // convert all files of the batch on a thread pool (all cores if -j is not set)
+    if (batchList != NULL) {
+        threadPool* pool = createThreadPool(threads > 0 ? threads : sysconf(_SC_NPROCESSORS_ONLN));
+        if (pool == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        tileCache tiles = {0};
+        int result = gamma_correct_batch(batchList, outputfile, &plan, pool, incremental ? &tiles : NULL);
+        freeTileCache(&tiles);
+        freeThreadPool(pool);
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        finish_trace(traceName);
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
+
+    // convert frame after frame from stdin to stdout
+    if (frames) {
+        threadPool* pool = NULL;
+        if (threads > 0 && (pool = createThreadPool(threads)) == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        tileCache tiles = {0};
+        int result = gamma_correct_frames(STDIN_FILENO, framesOutput, &plan, pool, incremental ? &tiles : NULL);
+        freeTileCache(&tiles);
+        freeThreadPool(pool);
+        close(framesOutput);
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        finish_trace(traceName);
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
+
+    // stream the image chunk by chunk instead of reading it as a whole
+    if (stream) {
+        threadPool* pool = NULL;
+        if (threads > 0 && (pool = createThreadPool(threads)) == NULL) {
+            exit(EXIT_FAILURE);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int result = gamma_correct_stream(filename, outputfile, &plan, pool, inPlace);
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        freeThreadPool(pool);
+
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        if (benchmarking == 1) {
+            printf("Streamed in %f seconds.\n", end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec));
+        }
+        finish_trace(traceName);
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
+
     // read input file
     imageFile input = {0};
     if(readPPMImage(&input, filename) != 0) {
         return 0;
     }
+    // the input mapping is read-only, in place only the pages the output overwrites are copied
+    if (inPlace && makeImageWritable(&input) != EXIT_SUCCESS) {
+        freeImageFile(&input);
+        exit(EXIT_FAILURE);
+    }
+
+    // every channel through its own table, RGB out
+    if (color) {
+        int result = gamma_correct_color_file(&input, outputfile, gammas, gammaCount, pointOps, 
+            threads, benchmarking, measureTime, inPlace);
+        freeImageFile(&input);
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        finish_trace(traceName);
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
+
+    // several gammas: one pass over the input, one output file per gamma
+    if (gammaCount > 1) {
+        int result = gamma_correct_multi_files(&input, outputfile, implementation, a, b, c, 
+            gammas, gammaCount, pointOps, rgbCache, threads, benchmarking, measureTime);
+        freeImageFile(&input);
+        if (result != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+        finish_trace(traceName);
+        printf("Done doing. Have a nice day : ^)\n");
+        exit(EXIT_SUCCESS);
+    }
 
     // prep output file
     imageFile output = {0};
-    output.content = malloc(input.width * input.heigth);
-    if(output.content == NULL) {
-        fprintf(stderr, "Malloc failed\n");
-        exit(EXIT_FAILURE);
-    }
     output.width = input.width;
     output.heigth = input.heigth;
+    if (mapOutput) {
+        // the implementation writes straight into the file
+        if(mapPGMImage(&output, outputfile) != 0) {
+            freeImageFile(&input);
+            exit(EXIT_FAILURE);
+        }
+    } else if (inPlace) {
+        // pixel i of the output only overwrites input bytes of pixels that are already read
+        output.content = input.content;
+        output.padding = input.padding;
+    } else if(allocImageContent(&output, (size_t)input.width * input.heigth) != EXIT_SUCCESS) {
+        exit(EXIT_FAILURE);
+    }
+    // both contents have room for whole vectors after the last pixel
+    int padded = input.padding >= IMAGE_PADDING && output.padding >= IMAGE_PADDING;
 
     double overallTime = 0.0;
     double averageTime = 0.0;
 
     // run selected implementation with specified options
-    switch (implementation) {
-        case 0:
-            printf("Using gamma_correct_asm_hash_simd\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_asm_hash_simd, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 1:
-            printf("Using gamma_correct_c_hash_SSE\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_c_hash_SSE, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 2:
-            printf("Using gamma_correct_asm_simd\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_asm_simd, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 3:
-            printf("Using gamma_correct_c_SSE\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_c_SSE, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 4:
-            printf("Using gamma_correct_asm\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_asm,  
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 5:
-            printf("Using gamma_correct_c\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_c, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 6:
-            printf("Using gamma_correct_asm_hash\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_asm_hash, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 7:
-            printf("Using gamma_correct_c_hash\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_c_hash, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        case 8:
-            printf("Using gamma_correct_c_naiv\n");
-            printf("This uses powf(float, float) from math.h for gamma corection\n");
-            overallTime = gamma_correct_generic(measureTime, &gamma_correct_c_naiv, 
-            input.content, input.width, input.heigth, a, b, c, gamma, output.content);
-            break;
-        default:
-            fprintf(stderr, "Invalid -V %s. Can only be 0, 1, 2, 3, 4 or unset option. Exiting.\n", optarg);
-            freeImageFile(&input);
-            freeImageFile(&output);
-            exit_help();
-            break;
-    }
+    if (threads == 0) {
+        overallTime = gamma_correct_generic(measureTime, &plan, 
+            input.content, input.width, input.heigth, output.content, padded);
 
-    averageTime = overallTime / measureTime;
+        averageTime = overallTime / measureTime;
 
-    // print out measured time if -B was set
-    if (benchmarking == 1) {
-        printf("Ran %d times. Took %f seconds with an average of %f seconds.\n", measureTime, overallTime, averageTime);
+        // print out measured time if -B was set
+        if (benchmarking == 1) {
+            printf("Ran %d times. Took %f seconds with an average of %f seconds.\n", measureTime, overallTime, averageTime);
+        }
+    } else if (benchmarking == 0) {
+        threadPool* pool = createThreadPool(threads);
+        if (pool == NULL) {
+            exit(EXIT_FAILURE);
+        }
+        start = traceNow();
+        gamma_correct_parallel(pool, &plan, 
+            input.content, input.width, input.heigth, output.content, padded);
+        traceRecord("kernel", start);
+        freeThreadPool(pool);
+    } else {
+        // measure scaling with 1, 2, 4, ... threads up to the requested thread count
+        double singleThreadTime = 0.0;
+        for (int t = 1; t <= threads; t = (t < threads && t * 2 > threads) ? threads : t * 2) {
+            threadPool* pool = createThreadPool(t);
+            if (pool == NULL) {
+                exit(EXIT_FAILURE);
+            }
+            overallTime = gamma_correct_parallel_generic(measureTime, pool, &plan, 
+                input.content, input.width, input.heigth, output.content, padded);
+            freeThreadPool(pool);
+
+            averageTime = overallTime / measureTime;
+            if (t == 1) {
+                singleThreadTime = overallTime;
+            }
+            printf("Threads %d: Ran %d times. Took %f seconds with an average of %f seconds. Speedup %.2fx\n", 
+                t, measureTime, overallTime, averageTime, singleThreadTime / overallTime);
+        }
     }
 
-    // write output to pgm file
-    writePGMImage(&output, outputfile);
+    // write output to pgm file (a mapped output file only has to be synced)
+    int result;
+    if (mapOutput) {
+        result = syncPGMImage(&output);
+    } else {
+        result = writePGMImage(&output, outputfile);
+    }
 
-    // free malloced pointers
+    // free malloced/mapped pointers (in place the output is part of the input)
     freeImageFile(&input);
-    freeImageFile(&output);
+    if (!inPlace) {
+        freeImageFile(&output);
+    }
 
+    finish_trace(traceName);
     printf("Done doing. Have a nice day : ^)\n");
-    exit(EXIT_SUCCESS);
+    exit(result);
 }
 
 // generic function so that we dont have to repeat the same code 5 times
-double gamma_correct_generic(int iterations, void (*function)(uint8_t*, 
-    int, int, float a, float, float, float, uint8_t*), 
-    uint8_t* inputContent, int width, int height, float a, float b, float c, float gamma, 
-    uint8_t* outputContent) {
+// padded (both contents have IMAGE_PADDING bytes after them) runs the kernel without its scalar tail
+double gamma_correct_generic(int iterations, gammaPlan* plan, 
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded) {
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        for (int i = 0; i < iterations; i++) {
+            uint64_t traceStart = traceNow();
+            if (padded) {
+                executeGammaPlanPadded(plan, inputContent, (size_t)width * height, outputContent);
+            } else {
+                executeGammaPlan(plan, inputContent, width, height, outputContent);
+            }
+            traceRecord("kernel", traceStart);
+        }
+
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        return time;
+}
+
+// same as gamma_correct_generic, but runs the implementation in row bands on the thread pool
+double gamma_correct_parallel_generic(int iterations, threadPool* pool, gammaPlan* plan, 
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded) {
 
         struct timespec start;
         clock_gettime(CLOCK_MONOTONIC, &start);
 
         for (int i = 0; i < iterations; i++) {
-            (*function)(inputContent, width, height, a, b, c, gamma, outputContent);
+            uint64_t traceStart = traceNow();
+            gamma_correct_parallel(pool, plan, inputContent, width, height, outputContent, padded);
+            traceRecord("kernel", traceStart);
         }
 
         struct timespec end;
         clock_gettime(CLOCK_MONOTONIC, &end);
         double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
         return time;
-}
\ No newline at end of file
+}
+
+// converts the input for all gammas at once (on threads if threads > 0) and writes
+// <outputfile without .pgm>_<gamma>.pgm for every gamma
+int gamma_correct_multi_files(imageFile* input, char* outputfile, int implementation, 
+    float a, float b, float c, float* gammas, int gammaCount, pointOpChain* pointOps, 
+    char* rgbCache, int threads, int benchmarking, int measureTime) {
+
+        gammaMultiPlan multiPlan;
+        uint64_t traceStart = traceNow();
+        initGammaMultiPlan(&multiPlan, &kernelRegistry[implementation], a, b, c, gammas, gammaCount, pointOps);
+        traceRecord("table", traceStart);
+        for (int k = 0; rgbCache != NULL && k < gammaCount; k++) {
+            if (attachRGBTable(&multiPlan.plans[k], rgbCache, NULL) != EXIT_SUCCESS) {
+                return EXIT_FAILURE;
+            }
+        }
+
+        imageFile outputs[MAX_GAMMAS] = {0};
+        uint8_t* outputContents[MAX_GAMMAS];
+        int result = EXIT_SUCCESS;
+        for (int k = 0; k < gammaCount; k++) {
+            outputs[k].width = input->width;
+            outputs[k].heigth = input->heigth;
+            if (allocImageContent(&outputs[k], (size_t)input->width * input->heigth) != EXIT_SUCCESS) {
+                result = EXIT_FAILURE;
+            }
+            outputContents[k] = outputs[k].content;
+        }
+
+        threadPool* pool = NULL;
+        if (result == EXIT_SUCCESS && threads > 0 && (pool = createThreadPool(threads)) == NULL) {
+            result = EXIT_FAILURE;
+        }
+
+        if (result == EXIT_SUCCESS) {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (int i = 0; i < measureTime; i++) {
+                traceStart = traceNow();
+                if (pool != NULL) {
+                    gamma_correct_parallel_multi(pool, &multiPlan, 
+                        input->content, input->width, input->heigth, outputContents);
+                } else {
+                    executeGammaMultiPlan(&multiPlan, input->content, input->width, input->heigth, outputContents);
+                }
+                traceRecord("kernel", traceStart);
+            }
+            struct timespec end;
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+            if (benchmarking == 1) {
+                printf("Ran %d times for %d gammas. Took %f seconds with an average of %f seconds.\n", 
+                    measureTime, gammaCount, time, time / measureTime);
+            }
+
+            size_t baseLength = strlen(outputfile) - 4;
+            for (int k = 0; k < gammaCount; k++) {
+                char outputName[4096];
+                snprintf(outputName, sizeof(outputName), "%.*s_%g.pgm", (int)baseLength, outputfile, gammas[k]);
+                if (writePGMImage(&outputs[k], outputName) != EXIT_SUCCESS) {
+                    result = EXIT_FAILURE;
+                }
+            }
+        }
+
+        freeThreadPool(pool);
+        for (int k = 0; k < gammaCount; k++) {
+            freeImageFile(&outputs[k]);
+            releaseRGBTable(&multiPlan.plans[k]);
+        }
+        return result;
+}
+
+// gamma corrects every channel of the input on its own (on threads if threads > 0) and writes
+// the color image to outputfile, gammas has 1 value for all channels or 3 (red, green, blue)
+// inPlace writes the result over the input
+int gamma_correct_color_file(imageFile* input, char* outputfile, float* gammas, int gammaCount, 
+    pointOpChain* pointOps, int threads, int benchmarking, int measureTime, int inPlace) {
+
+        gammaColorPlan colorPlan;
+        float channelGammas[3];
+        for (int c = 0; c < 3; c++) {
+            channelGammas[c] = gammaCount == 3 ? gammas[c] : gammaCount == 1 ? gammas[0] : NAN;
+        }
+        uint64_t traceStart = traceNow();
+        initGammaColorPlan(&colorPlan, channelGammas, pointOps);
+        traceRecord("table", traceStart);
+        printf("Using %s\n", colorPlan.function == gamma_correct_color_table ? 
+            "gamma_correct_color_table" : "gamma_correct_color_table_AVX512VBMI");
+
+        imageFile output = {0};
+        output.width = input->width;
+        output.heigth = input->heigth;
+        if (inPlace) {
+            output.content = input->content;
+        } else if (allocImageContent(&output, (size_t)input->width * input->heigth * 3) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+
+        threadPool* pool = NULL;
+        if (threads > 0 && (pool = createThreadPool(threads)) == NULL) {
+            if (!inPlace) {
+                freeImageFile(&output);
+            }
+            return EXIT_FAILURE;
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < measureTime; i++) {
+            traceStart = traceNow();
+            if (pool != NULL) {
+                gamma_correct_parallel_color(pool, &colorPlan, 
+                    input->content, input->width, input->heigth, output.content);
+            } else {
+                executeGammaColorPlan(&colorPlan, input->content, input->width, input->heigth, output.content);
+            }
+            traceRecord("kernel", traceStart);
+        }
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double time = end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec);
+        if (benchmarking == 1) {
+            printf("Ran %d times. Took %f seconds with an average of %f seconds (%.2f GB/s).\n", 
+                measureTime, time, time / measureTime, 
+                (double)input->width * input->heigth * 6 * measureTime / time / 1e9);
+        }
+
+        int result = writePPMImage(&output, outputfile);
+        freeThreadPool(pool);
+        if (!inPlace) {
+            freeImageFile(&output);
+        }
+        return result;
+}
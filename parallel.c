@@ -0,0 +1,295 @@
+/*
+    This file includes a persistent thread pool and the band parallel driver for all implementations.
+    Header file parallel.h defines the pool struct and the driver.
+*/
+
+#include "parallel.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+// Arguments of one gamma_correct_parallel call, shared by all bands
+typedef struct bandJob {
+  gammaPlan* plan;
+  uint8_t* inputContent;
+  uint8_t* outputContent;
+  int width;
+  int height;
+  int bandRows;
+  int padded; // both contents are padded, the last band runs whole vectors
+  // in place (outputContent == inputContent): 1 for every band that is done, NULL otherwise
+  int* bandsDone;
+} bandJob;
+
+// Arguments of one gamma_correct_parallel_multi call, shared by all bands
+typedef struct multiBandJob {
+  gammaMultiPlan* multiPlan;
+  uint8_t* inputContent;
+  uint8_t** outputContents;
+  int width;
+  int height;
+  int bandRows;
+} multiBandJob;
+
+// Arguments of one gamma_correct_parallel_color call, shared by all bands
+typedef struct colorBandJob {
+  gammaColorPlan* colorPlan;
+  uint8_t* inputContent;
+  uint8_t* outputContent;
+  int width;
+  int height;
+  int bandRows;
+} colorBandJob;
+
+// Takes tasks until all tasks of the current run are taken
+static void workOnTasks(threadPool* pool) {
+    int index;
+    while((index = __atomic_fetch_add(&pool->nextTask, 1, __ATOMIC_RELAXED)) < pool->taskCount) {
+        pool->task(pool->args, index);
+    }
+}
+
+// Main loop of every worker thread: wait for a new run, work on it, report back
+static void* workerThread(void* args) {
+    threadPool* pool = args;
+    unsigned long seenGeneration = 0;
+
+    while(1) {
+        pthread_mutex_lock(&pool->lock);
+        while(pool->generation == seenGeneration && !pool->shutdown)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if(pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        seenGeneration = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        workOnTasks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if(--pool->busyWorkers == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+// Creates a pool with threadCount - 1 workers, the calling thread is the last one
+threadPool* createThreadPool(int threadCount) {
+    threadPool* pool = calloc(1, sizeof(threadPool));
+    if(!pool) {
+        fprintf(stderr, "createThreadPool: Malloc failed\n");
+        return NULL;
+    }
+    if(threadCount < 1)
+        threadCount = 1;
+
+    pool->threads = calloc(threadCount, sizeof(pthread_t));
+    if(!pool->threads) {
+        fprintf(stderr, "createThreadPool: Malloc failed\n");
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    pool->threadCount = 1;
+    for(int i = 0; i < threadCount - 1; i++) {
+        if(pthread_create(&pool->threads[i], NULL, workerThread, pool) != 0) {
+            fprintf(stderr, "createThreadPool: Could only start %d threads\n", pool->threadCount);
+            break;
+        }
+        pool->threadCount++;
+    }
+    return pool;
+}
+
+// Runs task(args, 0) to task(args, taskCount - 1) on all threads of the pool and waits for them
+void runThreadPool(threadPool* pool, void (*task)(void* args, int index),
+    void* args, int taskCount) {
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->args = args;
+    pool->taskCount = taskCount;
+    pool->nextTask = 0;
+    pool->busyWorkers = pool->threadCount - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    workOnTasks(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while(pool->busyWorkers > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Stops all workers and frees the pool
+void freeThreadPool(threadPool* pool) {
+    if(pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(int i = 0; i < pool->threadCount - 1; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+}
+
+// In place the output of band "index" overwrites the input of an earlier band (output byte i is
+// input byte i of the same buffer, 3 input bytes per output byte), so it waits until those bands are done.
+// Bands are taken in order and only wait for earlier ones, so they never wait for each other.
+static void waitForInputBands(bandJob* job, int index, int rows, int padded) {
+    size_t bandInputBytes = (size_t)job->bandRows * job->width * 3;
+    size_t outputStart = (size_t)index * job->bandRows * job->width;
+    size_t outputEnd = outputStart + (size_t)rows * job->width + (padded ? PLAN_VECTOR_PIXELS : 0);
+
+    // band 0 writes over its own input, which every implementation reads before it writes there
+    int last = (outputEnd - 1) / bandInputBytes;
+    if(last > index - 1)
+        last = index - 1;
+    for(int band = outputStart / bandInputBytes; band <= last; band++) {
+        while(!__atomic_load_n(&job->bandsDone[band], __ATOMIC_ACQUIRE))
+            sched_yield();
+    }
+}
+
+// Runs the kernel on the rows of band "index"
+static void gammaCorrectBand(void* args, int index) {
+    bandJob* job = args;
+    int firstRow = index * job->bandRows;
+    int rows = job->height - firstRow;
+    if(rows > job->bandRows)
+        rows = job->bandRows;
+
+    uint8_t* input = job->inputContent + (size_t)firstRow * job->width * 3;
+    uint8_t* output = job->outputContent + (size_t)firstRow * job->width;
+    int padded = job->padded && firstRow + rows == job->height;
+
+    uint64_t start = traceNow();
+    if(job->bandsDone != NULL)
+        waitForInputBands(job, index, rows, padded);
+    // the size of the whole image decides if the bands stream past the caches
+    executeGammaPlanBand(job->plan, input, (size_t)job->width * rows, output, 
+        (size_t)job->width * job->height, padded);
+    if(job->bandsDone != NULL)
+        __atomic_store_n(&job->bandsDone[index], 1, __ATOMIC_RELEASE);
+    traceRecord("band", start);
+}
+
+// Gamma correction with any implementation, split into row bands of about BAND_BYTES
+// All bands share the hash table of the plan. padded is 1 if both contents have IMAGE_PADDING
+// bytes after them, then the last band has no scalar tail (executeGammaPlanPadded).
+// outputContent can be inputContent (in place), bands then wait for the bands they overwrite.
+void gamma_correct_parallel(threadPool* pool, gammaPlan* plan,
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded) {
+        bandJob job = {
+            .plan = plan, .inputContent = inputContent, .outputContent = outputContent,
+            .width = width, .height = height, .padded = padded
+        };
+
+        if(width <= 0 || height <= 0)
+            return;
+
+        job.bandRows = BAND_BYTES / ((size_t)width * 3);
+        if(job.bandRows < 1)
+            job.bandRows = 1;
+        int bands = (height + job.bandRows - 1) / job.bandRows;
+
+        if(inputContent == outputContent) {
+            job.bandsDone = calloc(bands, sizeof(int));
+            if(!job.bandsDone) {
+                // one band after the other is always safe in place
+                fprintf(stderr, "gamma_correct_parallel: Malloc failed, running on one thread\n");
+                for(int band = 0; band < bands; band++)
+                    gammaCorrectBand(&job, band);
+                return;
+            }
+        }
+
+        runThreadPool(pool, gammaCorrectBand, &job, bands);
+        free(job.bandsDone);
+}
+
+// Runs all gammas of the multi plan on the rows of band "index"
+static void gammaCorrectMultiBand(void* args, int index) {
+    multiBandJob* job = args;
+    int firstRow = index * job->bandRows;
+    int rows = job->height - firstRow;
+    if(rows > job->bandRows)
+        rows = job->bandRows;
+
+    uint8_t* outputs[MAX_GAMMAS];
+    for(int k = 0; k < job->multiPlan->count; k++)
+        outputs[k] = job->outputContents[k] + (size_t)firstRow * job->width;
+
+    uint64_t start = traceNow();
+    executeGammaMultiPlan(job->multiPlan, job->inputContent + (size_t)firstRow * job->width * 3,
+        job->width, rows, outputs);
+    traceRecord("band", start);
+}
+
+// Same as gamma_correct_parallel for all gammas of a multi plan, outputContents[k] gets gamma k
+void gamma_correct_parallel_multi(threadPool* pool, gammaMultiPlan* multiPlan,
+    uint8_t* inputContent, int width, int height, uint8_t** outputContents) {
+        multiBandJob job = {
+            .multiPlan = multiPlan, .inputContent = inputContent, .outputContents = outputContents,
+            .width = width, .height = height
+        };
+
+        if(width <= 0 || height <= 0)
+            return;
+
+        job.bandRows = BAND_BYTES / ((size_t)width * 3);
+        if(job.bandRows < 1)
+            job.bandRows = 1;
+        int bands = (height + job.bandRows - 1) / job.bandRows;
+
+        runThreadPool(pool, gammaCorrectMultiBand, &job, bands);
+}
+
+// Runs the color plan on the rows of band "index"
+static void gammaCorrectColorBand(void* args, int index) {
+    colorBandJob* job = args;
+    int firstRow = index * job->bandRows;
+    int rows = job->height - firstRow;
+    if(rows > job->bandRows)
+        rows = job->bandRows;
+
+    size_t offset = (size_t)firstRow * job->width * 3;
+    uint64_t start = traceNow();
+    executeGammaColorPlan(job->colorPlan, job->inputContent + offset, job->width, rows,
+        job->outputContent + offset);
+    traceRecord("band", start);
+}
+
+// Same as gamma_correct_parallel for the color plan, outputContent has 3 bytes per pixel
+// and can be inputContent (every band only overwrites its own input)
+void gamma_correct_parallel_color(threadPool* pool, gammaColorPlan* colorPlan,
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent) {
+        colorBandJob job = {
+            .colorPlan = colorPlan, .inputContent = inputContent, .outputContent = outputContent,
+            .width = width, .height = height
+        };
+
+        if(width <= 0 || height <= 0)
+            return;
+
+        job.bandRows = BAND_BYTES / ((size_t)width * 3);
+        if(job.bandRows < 1)
+            job.bandRows = 1;
+        int bands = (height + job.bandRows - 1) / job.bandRows;
+
+        runThreadPool(pool, gammaCorrectColorBand, &job, bands);
+}
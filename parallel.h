@@ -0,0 +1,40 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "gamma_correct.h"
+#include "plan.h"
+
+// Input bytes of one band, small enough that a band and its output stay in L2
+#define BAND_BYTES (192 * 1024)
+
+// Defines a pool of worker threads that is kept alive between runs
+typedef struct threadPool {
+  int threadCount; // worker threads + the thread that calls runThreadPool
+  pthread_t* threads;
+  pthread_mutex_t lock;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  unsigned long generation; // counts calls of runThreadPool so workers notice new work
+  int busyWorkers;
+  int shutdown;
+  void (*task)(void* args, int index);
+  void* args;
+  int taskCount;
+  int nextTask; // next task index to take, shared by all threads
+} threadPool;
+
+threadPool* createThreadPool(int threadCount);
+void runThreadPool(threadPool* pool, void (*task)(void* args, int index),
+    void* args, int taskCount);
+void freeThreadPool(threadPool* pool);
+
+void gamma_correct_parallel(threadPool* pool, gammaPlan* plan,
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent, int padded);
+void gamma_correct_parallel_multi(threadPool* pool, gammaMultiPlan* multiPlan,
+    uint8_t* inputContent, int width, int height, uint8_t** outputContents);
+void gamma_correct_parallel_color(threadPool* pool, gammaColorPlan* colorPlan,
+    uint8_t* inputContent, int width, int height, uint8_t* outputContent);
+
+#endif
@@ -0,0 +1,123 @@
+/*
+    This file includes the hardware performance counters (perf_event_open) used by the benchmark mode.
+    Every counter is opened on its own, so a missing event only disables that one counter.
+    Header file perf_counters.h defines the counters.
+*/
+
+#include "perf_counters.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static char* counterNames[PERF_COUNTER_COUNT] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses",
+    "frontend_stalls", "backend_stalls", "page_faults"
+};
+
+// perf_event_attr type and config of every counter
+static const uint32_t counterTypes[PERF_COUNTER_COUNT] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HW_CACHE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+};
+static const uint64_t counterConfigs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_STALLED_CYCLES_FRONTEND,
+    PERF_COUNT_HW_STALLED_CYCLES_BACKEND,
+    PERF_COUNT_SW_PAGE_FAULTS
+};
+
+char* perfCounterName(perfCounter counter) {
+    return counterNames[counter];
+}
+
+// Reads perf_event_paranoid for the error message, -1 if it can not be read
+static int readParanoid() {
+    int paranoid = -1;
+    FILE* file = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+    if(file) {
+        if(fscanf(file, "%d", &paranoid) != 1)
+            paranoid = -1;
+        fclose(file);
+    }
+    return paranoid;
+}
+
+// Opens all counters of the calling thread (user space only, so perf_event_paranoid <= 2 is enough)
+// Returns the number of hardware counters that could be opened, unavailable ones are reported once.
+int openPerfCounters(perfCounters* counters) {
+    int hardwareCounters = 0;
+    int lastError = 0;
+
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        struct perf_event_attr attributes;
+        memset(&attributes, 0, sizeof(attributes));
+        attributes.size = sizeof(attributes);
+        attributes.type = counterTypes[i];
+        attributes.config = counterConfigs[i];
+        attributes.disabled = 1;
+        attributes.exclude_kernel = 1;
+        attributes.exclude_hv = 1;
+        attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        counters->fds[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+        counters->values[i] = -1;
+        if(counters->fds[i] == -1)
+            lastError = errno;
+        else if(counterTypes[i] != PERF_TYPE_SOFTWARE)
+            hardwareCounters++;
+    }
+
+    if(hardwareCounters == 0) {
+        fprintf(stderr, "openPerfCounters: No hardware counters (%s, perf_event_paranoid is %d), "
+            "only showing the software ones\n", strerror(lastError), readParanoid());
+    } else if(hardwareCounters < PERF_COUNTER_COUNT - 1) {
+        fprintf(stderr, "openPerfCounters: Only %d of %d hardware counters are available on this CPU\n",
+            hardwareCounters, PERF_COUNTER_COUNT - 1);
+    }
+    return hardwareCounters;
+}
+
+// Resets and enables all open counters
+void startPerfCounters(perfCounters* counters) {
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if(counters->fds[i] != -1) {
+            ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+// Disables all open counters and reads them into values (-1 for counters that are not available)
+// If the kernel had to multiplex the counters, the count is scaled up to the whole time.
+void stopPerfCounters(perfCounters* counters) {
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if(counters->fds[i] != -1)
+            ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t data[3]; // value, time enabled, time running
+        counters->values[i] = -1;
+        if(counters->fds[i] == -1 || read(counters->fds[i], data, sizeof(data)) != sizeof(data))
+            continue;
+        if(data[2] == 0)
+            continue;
+        counters->values[i] = data[2] < data[1] ? (double)data[0] * data[1] / data[2] : data[0];
+    }
+}
+
+void closePerfCounters(perfCounters* counters) {
+    for(int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if(counters->fds[i] != -1)
+            close(counters->fds[i]);
+        counters->fds[i] = -1;
+    }
+}
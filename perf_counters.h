@@ -0,0 +1,32 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+
+// Hardware (and one software) counters read around a kernel run
+typedef enum perfCounter {
+  PERF_CYCLES,
+  PERF_INSTRUCTIONS,
+  PERF_L1D_MISSES,      // L1 data cache read misses
+  PERF_LLC_MISSES,      // last level cache read misses
+  PERF_BRANCH_MISSES,
+  PERF_FRONTEND_STALLS, // cycles the frontend delivered no instructions, not on every CPU
+  PERF_BACKEND_STALLS,  // cycles the backend accepted no instructions, not on every CPU
+  PERF_PAGE_FAULTS,     // software counter, also works without a PMU
+  PERF_COUNTER_COUNT
+} perfCounter;
+
+// Open counters of the calling thread, fds[i] is -1 if counter i is not available
+// (no PMU in a VM, perf_event_paranoid too high or the CPU does not have the event)
+typedef struct perfCounters {
+  int fds[PERF_COUNTER_COUNT];
+  double values[PERF_COUNTER_COUNT]; // counts of the last start/stop, scaled if multiplexed
+} perfCounters;
+
+int openPerfCounters(perfCounters* counters);
+void startPerfCounters(perfCounters* counters);
+void stopPerfCounters(perfCounters* counters);
+void closePerfCounters(perfCounters* counters);
+char* perfCounterName(perfCounter counter);
+
+#endif
@@ -0,0 +1,209 @@
+/*
+    This file includes the plan API: an implementation together with its precomputed hash table.
+    Header file plan.h defines the plan struct.
+*/
+
+#include "plan.h"
+#include "kernels.h"
+#include "rgb_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+
+// Allocates and initializes a plan, kernel NULL uses the widest implementation the CPU supports
+gammaPlan* createGammaPlan(gammaKernel* kernel, float a, float b, float c, float gamma) {
+    gammaPlan* plan = malloc(sizeof(gammaPlan));
+    if(!plan) {
+        fprintf(stderr, "createGammaPlan: Malloc failed\n");
+        return NULL;
+    }
+    initGammaPlan(plan, kernel, a, b, c, gamma);
+    return plan;
+}
+
+// Initializes a plan that is already allocated (e.g. on the stack) and builds its hash table
+void initGammaPlan(gammaPlan* plan, gammaKernel* kernel, float a, float b, float c, float gamma) {
+    initGammaPlanWithOps(plan, kernel, a, b, c, gamma, NULL);
+}
+
+// Same as initGammaPlan, then the point operations are folded into the hash table
+// (only implementations with a hash table). A NAN gamma starts with the identity instead of a gamma table.
+void initGammaPlanWithOps(gammaPlan* plan, gammaKernel* kernel, float a, float b, float c, float gamma,
+    pointOpChain* ops) {
+    if(kernel == NULL)
+        kernel = &kernelRegistry[getDefaultKernel()];
+
+    plan->kernel = kernel;
+    plan->a = a;
+    plan->b = b;
+    plan->c = c;
+    plan->gamma = gamma;
+    plan->rgbTable = NULL;
+    plan->rgbMapping = NULL;
+    plan->rgbMappingSize = 0;
+    plan->streaming = STREAMING_AUTO;
+    plan->hasHash = kernel->buildHash != NULL;
+    if(plan->hasHash && isnan(gamma)) {
+        for(int i = 0; i < 256; i++)
+            plan->hash[i] = i;
+    } else if(plan->hasHash) {
+        kernel->buildHash(plan->hash, gamma);
+    }
+    if(plan->hasHash && ops != NULL)
+        applyPointOps(ops, plan->kernel, plan->hash);
+}
+
+// Bytes of input and output (4 per pixel) from which an image is much larger than the last level cache:
+// twice its size, so even with the output in cache most of the input has to come from DRAM
+size_t getStreamingThreshold() {
+    static size_t threshold = 0;
+    if(threshold == 0) {
+        long cacheSize = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        threshold = cacheSize > 0 ? 2 * (size_t)cacheSize : STREAMING_MIN_BYTES;
+    }
+    return threshold;
+}
+
+// Returns 1 if the plan runs an image of imagePixels pixels with kernel->streamingHashFunction
+int usesStreamingKernel(gammaPlan* plan, size_t imagePixels) {
+    if(plan->rgbTable != NULL || !plan->hasHash || plan->kernel->streamingHashFunction == NULL)
+        return 0;
+    if(plan->streaming != STREAMING_AUTO)
+        return plan->streaming;
+    return imagePixels * 4 > getStreamingThreshold();
+}
+
+// Runs the table, the hash table or the implementation itself on width x height pixels
+static void runGammaPlan(gammaPlan* plan, uint8_t* inputContent, int width, int height,
+    uint8_t* outputContent, int streaming) {
+        if(plan->rgbTable != NULL) {
+            gamma_correct_rgb_table(inputContent, width, height, outputContent, plan->rgbTable);
+        } else if(streaming) {
+            plan->kernel->streamingHashFunction(inputContent, width, height, plan->a, plan->b, plan->c, 
+                outputContent, plan->hash);
+        } else if(plan->hasHash) {
+            plan->kernel->hashFunction(inputContent, width, height, plan->a, plan->b, plan->c, 
+                outputContent, plan->hash);
+        } else {
+            plan->kernel->function(inputContent, width, height, plan->a, plan->b, plan->c, plan->gamma, 
+                outputContent);
+        }
+}
+
+// Gamma correction of one image with the plan
+// outputContent can be inputContent (in place): every implementation reads a pixel before it
+// writes output byte i, which only overlaps input bytes of pixels before it
+void executeGammaPlan(gammaPlan* plan, uint8_t* inputContent, int width, int height,
+    uint8_t* outputContent) {
+        runGammaPlan(plan, inputContent, width, height, outputContent, 
+            usesStreamingKernel(plan, (size_t)width * height));
+}
+
+// Same as executeGammaPlan on pixels pixels, but rounds them up to whole PLAN_VECTOR_PIXELS
+// so the vector loop of the kernel runs to the end and its scalar tail has nothing left.
+// Both buffers must be padded (imageFile.padding of at least IMAGE_PADDING), the rounded up
+// pixels read and write garbage in the padding.
+void executeGammaPlanPadded(gammaPlan* plan, uint8_t* inputContent, size_t pixels,
+    uint8_t* outputContent) {
+        executeGammaPlanBand(plan, inputContent, pixels, outputContent, pixels, 1);
+}
+
+// Gamma correction of pixels pixels that are part of an image of imagePixels (a band), 
+// the image size chooses between the regular and the streaming kernel.
+// padded runs whole vectors past the end like executeGammaPlanPadded.
+void executeGammaPlanBand(gammaPlan* plan, uint8_t* inputContent, size_t pixels,
+    uint8_t* outputContent, size_t imagePixels, int padded) {
+        int streaming = usesStreamingKernel(plan, imagePixels);
+        if(padded)
+            pixels = (pixels + PLAN_VECTOR_PIXELS - 1) / PLAN_VECTOR_PIXELS * PLAN_VECTOR_PIXELS;
+        while(pixels > INT_MAX) {
+            // the kernels count pixels in an int, split in rows of whole vectors
+            int part = INT_MAX / PLAN_VECTOR_PIXELS * PLAN_VECTOR_PIXELS;
+            runGammaPlan(plan, inputContent, part, 1, outputContent, streaming);
+            inputContent += (size_t)part * 3;
+            outputContent += part;
+            pixels -= part;
+        }
+        runGammaPlan(plan, inputContent, pixels, 1, outputContent, streaming);
+}
+
+// Initializes one plan per gamma (at most MAX_GAMMAS), kernel NULL uses the default implementation
+// ops (NULL for none) are applied after every gamma
+void initGammaMultiPlan(gammaMultiPlan* multiPlan, gammaKernel* kernel, float a, float b, float c,
+    float* gammas, int count, pointOpChain* ops) {
+        if(count > MAX_GAMMAS)
+            count = MAX_GAMMAS;
+        multiPlan->count = count;
+        memset(multiPlan->packedHashes, 0, sizeof(multiPlan->packedHashes));
+        for(int k = 0; k < count; k++) {
+            initGammaPlanWithOps(&multiPlan->plans[k], kernel, a, b, c, gammas[k], ops);
+            for(int i = 0; multiPlan->plans[k].hasHash && i < 256; i++)
+                multiPlan->packedHashes[k / 4][i] |= (uint32_t)multiPlan->plans[k].hash[i] << (8 * (k % 4));
+        }
+        for(int i = 0; i < 256; i++)
+            multiPlan->identity[i] = i;
+        multiPlan->fanOut = getCpuFeatures() & CPU_AVX2 ? gamma_correct_fan_out_AVX2 : gamma_correct_fan_out;
+}
+
+// Gamma correction of one image (or a part of it) for all gammas in one pass over the input,
+// outputContents[k] gets the result of gamma k
+void executeGammaMultiPlan(gammaMultiPlan* multiPlan, uint8_t* inputContent, int width, int height,
+    uint8_t** outputContents) {
+        gammaPlan* first = &multiPlan->plans[0];
+        // RGB tables replace the keys, so those plans run one by one on every block
+        int sharedKeys = first->hasHash && first->rgbTable == NULL;
+        size_t pixels = (size_t)width * height;
+        uint8_t keys[MULTI_BLOCK_PIXELS];
+        uint8_t* outputs[MAX_GAMMAS];
+
+        for(size_t i = 0; i < pixels; i += MULTI_BLOCK_PIXELS) {
+            int blockPixels = pixels - i < MULTI_BLOCK_PIXELS ? pixels - i : MULTI_BLOCK_PIXELS;
+            uint8_t* input = inputContent + i * 3;
+
+            for(int k = 0; k < multiPlan->count; k++)
+                outputs[k] = outputContents[k] + i;
+            if(sharedKeys) {
+                first->kernel->hashFunction(input, blockPixels, 1, first->a, first->b, first->c,
+                    keys, multiPlan->identity);
+                multiPlan->fanOut(keys, blockPixels, multiPlan->packedHashes, outputs, multiPlan->count);
+            } else {
+                for(int k = 0; k < multiPlan->count; k++)
+                    executeGammaPlan(&multiPlan->plans[k], input, blockPixels, 1, outputs[k]);
+            }
+        }
+}
+
+// Builds the table of every channel from its gamma (gammas[0] red, [1] green, [2] blue) and the ops
+// (NULL for none). The tables are exact, there is no grayscale key the hash implementations could share.
+// A NAN gamma starts with the identity.
+void initGammaColorPlan(gammaColorPlan* colorPlan, float* gammas, pointOpChain* ops) {
+    for(int c = 0; c < 3; c++) {
+        if(isnan(gammas[c])) {
+            for(int i = 0; i < 256; i++)
+                colorPlan->tables[c][i] = i;
+        } else {
+            gamma_correct_build_table_exact(colorPlan->tables[c], gammas[c]);
+        }
+        if(ops != NULL)
+            applyPointOps(ops, NULL, colorPlan->tables[c]);
+    }
+    colorPlan->function = getCpuFeatures() & CPU_AVX512VBMI
+        ? gamma_correct_color_table_AVX512VBMI : gamma_correct_color_table;
+}
+
+// Per channel gamma correction of one image (or a part of it), outputContent has 3 bytes per pixel
+void executeGammaColorPlan(gammaColorPlan* colorPlan, uint8_t* inputContent, int width, int height,
+    uint8_t* outputContent) {
+        colorPlan->function(inputContent, width, height, outputContent, colorPlan->tables);
+}
+
+// Frees a plan from createGammaPlan
+void freeGammaPlan(gammaPlan* plan) {
+    if(plan == NULL)
+        return;
+    releaseRGBTable(plan);
+    free(plan);
+}
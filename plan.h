@@ -0,0 +1,83 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <stdint.h>
+#include "gamma_correct.h"
+#include "point_ops.h"
+
+// A ready to run gamma correction: the implementation, its parameters and its hash table
+// Create it once and execute it on as many images as needed, the table is never built again
+typedef struct gammaPlan {
+  gammaKernel* kernel;
+  float a;
+  float b;
+  float c;
+  float gamma;
+  int hasHash; // 1 if hash is filled (implementations with a hash table)
+  uint8_t hash[256];
+  // NULL or the output of every RGB triple, index (red << 16) | (green << 8) | blue (see rgb_cache.c)
+  uint8_t* rgbTable;
+  uint8_t* rgbMapping; // mapping that holds rgbTable, unmapped by releaseRGBTable
+  size_t rgbMappingSize;
+  // STREAMING_AUTO, or 0 / 1 to never / always use kernel->streamingHashFunction
+  int streaming;
+} gammaPlan;
+
+// Uses the streaming version of the kernel for images of more than getStreamingThreshold() bytes
+#define STREAMING_AUTO -1
+// Streaming threshold if the size of the last level cache is unknown
+#define STREAMING_MIN_BYTES ((size_t)64 << 20)
+
+// Pixels of the widest kernel iteration, every kernel's vector loop covers a multiple of it
+// without a scalar tail (see executeGammaPlanPadded)
+#define PLAN_VECTOR_PIXELS 64
+
+// Most gammas one --gamma list (and one pass over the input) can have
+#define MAX_GAMMAS 16
+// Pixels per block of a multi gamma pass, the keys and the block of every output stay in L1/L2
+#define MULTI_BLOCK_PIXELS 4096
+
+// One plan per gamma, all with the same implementation and coefficients.
+// Implementations with a hash table compute the grayscale key of a pixel once
+// and look it up in all tables, the others run every plan on the same block while it is in cache.
+typedef struct gammaMultiPlan {
+  int count;
+  gammaPlan plans[MAX_GAMMAS];
+  uint8_t identity[256]; // hash table that turns the hash implementation into a key function
+  // byte j of packedHashes[g][key] is the output of gamma 4 * g + j
+  uint32_t packedHashes[MAX_GAMMAS / 4][256];
+  // gamma_correct_fan_out or its widest version this CPU supports
+  void (*fanOut)(uint8_t* keys, int pixels, 
+    uint32_t (*packedHashes)[256], uint8_t** outputContents, int count);
+} gammaMultiPlan;
+
+// Per channel gamma correction (color mode), RGB in and RGB out
+typedef struct gammaColorPlan {
+  uint8_t tables[3][256]; // red, green, blue
+  // gamma_correct_color_table or its widest version this CPU supports
+  void (*function)(uint8_t* inputContent, 
+    int width, int height, uint8_t* outputContent, uint8_t (*tables)[256]);
+} gammaColorPlan;
+
+gammaPlan* createGammaPlan(gammaKernel* kernel, float a, float b, float c, float gamma);
+void initGammaPlan(gammaPlan* plan, gammaKernel* kernel, float a, float b, float c, float gamma);
+void initGammaPlanWithOps(gammaPlan* plan, gammaKernel* kernel, float a, float b, float c, float gamma,
+    pointOpChain* ops);
+void executeGammaPlan(gammaPlan* plan, uint8_t* inputContent, int width, int height,
+    uint8_t* outputContent);
+void executeGammaPlanPadded(gammaPlan* plan, uint8_t* inputContent, size_t pixels,
+    uint8_t* outputContent);
+void executeGammaPlanBand(gammaPlan* plan, uint8_t* inputContent, size_t pixels,
+    uint8_t* outputContent, size_t imagePixels, int padded);
+size_t getStreamingThreshold();
+int usesStreamingKernel(gammaPlan* plan, size_t imagePixels);
+void freeGammaPlan(gammaPlan* plan);
+void initGammaMultiPlan(gammaMultiPlan* multiPlan, gammaKernel* kernel, float a, float b, float c,
+    float* gammas, int count, pointOpChain* ops);
+void executeGammaMultiPlan(gammaMultiPlan* multiPlan, uint8_t* inputContent, int width, int height,
+    uint8_t** outputContents);
+void initGammaColorPlan(gammaColorPlan* colorPlan, float* gammas, pointOpChain* ops);
+void executeGammaColorPlan(gammaColorPlan* colorPlan, uint8_t* inputContent, int width, int height,
+    uint8_t* outputContent);
+
+#endif
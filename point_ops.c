@@ -0,0 +1,254 @@
+/*
+    This file includes the point operations (--ops): levels, invert, threshold, brightness, contrast, gamma
+    and the standard transfer curves (--curve).
+    Each one maps a gray value to a gray value, so a whole chain is composed into the 256 entry hash table
+    once and costs nothing per pixel, no matter how many operations it has.
+    Header file point_ops.h defines the operations and the chain.
+*/
+
+#include "point_ops.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Name and number of values (minimum and maximum) of every operation, in pointOpType order
+static const struct {
+  char* name;
+  int minValues;
+  int maxValues;
+} opFormats[] = {
+  {"gamma", 1, 1},
+  {"levels", 2, 4},
+  {"invert", 0, 0},
+  {"threshold", 1, 1},
+  {"brightness", 1, 1},
+  {"contrast", 1, 1},
+  {"curve", 0, 0} // takes a name instead of values
+};
+
+// Names of every transferCurve in order, then the short names and what they stand for
+static char* curveNames[] = {"linear-to-srgb", "srgb-to-linear", "linear-to-rec709", "rec709-to-linear",
+    "linear-to-pq", "pq-to-linear"};
+static const struct {
+  char* name;
+  transferCurve curve;
+} curveAliases[] = {
+  {"srgb", CURVE_LINEAR_TO_SRGB},
+  {"rec709", CURVE_LINEAR_TO_REC709},
+  {"pq", CURVE_LINEAR_TO_PQ}
+};
+
+// SMPTE ST 2084 constants
+#define PQ_M1 (2610.0 / 16384)
+#define PQ_M2 (2523.0 / 4096 * 128)
+#define PQ_C1 (3424.0 / 4096)
+#define PQ_C2 (2413.0 / 4096 * 32)
+#define PQ_C3 (2392.0 / 4096 * 32)
+
+// Sets curve to the curve called name (full or short name), returns EXIT_FAILURE for unknown names
+int parseCurve(char* name, transferCurve* curve) {
+    for(int i = 0; i < (int)(sizeof(curveNames) / sizeof(curveNames[0])); i++) {
+        if(strcmp(name, curveNames[i]) == 0) {
+            *curve = i;
+            return EXIT_SUCCESS;
+        }
+    }
+    for(int i = 0; i < (int)(sizeof(curveAliases) / sizeof(curveAliases[0])); i++) {
+        if(strcmp(name, curveAliases[i].name) == 0) {
+            *curve = curveAliases[i].curve;
+            return EXIT_SUCCESS;
+        }
+    }
+    return EXIT_FAILURE;
+}
+
+// Value of the curve at x in [0, 1]
+static double applyCurve(transferCurve curve, double x) {
+    switch(curve) {
+        case CURVE_LINEAR_TO_SRGB:
+            return x <= 0.0031308 ? 12.92 * x : 1.055 * pow(x, 1.0 / 2.4) - 0.055;
+        case CURVE_SRGB_TO_LINEAR:
+            return x <= 0.04045 ? x / 12.92 : pow((x + 0.055) / 1.055, 2.4);
+        case CURVE_LINEAR_TO_REC709:
+            return x < 0.018 ? 4.5 * x : 1.099 * pow(x, 0.45) - 0.099;
+        case CURVE_REC709_TO_LINEAR:
+            return x < 0.081 ? x / 4.5 : pow((x + 0.099) / 1.099, 1.0 / 0.45);
+        case CURVE_LINEAR_TO_PQ: {
+            double power = pow(x, PQ_M1);
+            return pow((PQ_C1 + PQ_C2 * power) / (1.0 + PQ_C3 * power), PQ_M2);
+        }
+        case CURVE_PQ_TO_LINEAR: {
+            double power = pow(x, 1.0 / PQ_M2);
+            double numerator = power - PQ_C1 > 0.0 ? power - PQ_C1 : 0.0;
+            return pow(numerator / (PQ_C2 - PQ_C3 * power), 1.0 / PQ_M1);
+        }
+        default:
+            return x;
+    }
+}
+
+// Rounds and clamps to a gray value
+static inline uint8_t toGray(float value) {
+    if(value <= 0.0f)
+        return 0;
+    if(value >= 255.0f)
+        return 255;
+    return (uint8_t)(value + 0.5f);
+}
+
+// Checks the ranges of the values of one parsed operation
+static int checkPointOp(pointOp* op, int valueCount) {
+    float* values = op->values;
+    switch(op->type) {
+        case OP_GAMMA:
+        case OP_CONTRAST:
+            return values[0] >= 0.0f;
+        case OP_LEVELS:
+            if(valueCount == 3)
+                return 0;
+            if(valueCount == 2) {
+                values[2] = 0.0f;
+                values[3] = 255.0f;
+            }
+            return values[0] >= 0.0f && values[0] < values[1] && values[1] <= 255.0f
+                && values[2] >= 0.0f && values[2] <= 255.0f && values[3] >= 0.0f && values[3] <= 255.0f;
+        case OP_THRESHOLD:
+            return values[0] >= 0.0f && values[0] <= 256.0f;
+        case OP_BRIGHTNESS:
+            return values[0] >= -255.0f && values[0] <= 255.0f;
+        default:
+            return 1;
+    }
+}
+
+// Parses a comma separated chain like "gamma=2.2,levels=10:240,invert,curve=srgb" into chain
+// Returns EXIT_FAILURE (and prints why) for unknown operations, wrong value counts or ranges
+int parsePointOps(char* text, pointOpChain* chain) {
+    chain->count = 0;
+    return appendPointOps(text, chain);
+}
+
+// Same as parsePointOps, but adds the operations after the ones already in chain
+int appendPointOps(char* text, pointOpChain* chain) {
+    char* copy = strdup(text);
+    char* position = NULL;
+    int firstCount = chain->count;
+    int result = EXIT_SUCCESS;
+    if(!copy) {
+        fprintf(stderr, "parsePointOps: Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+
+    for(char* token = strtok_r(copy, ",", &position); token != NULL && result == EXIT_SUCCESS;
+        token = strtok_r(NULL, ",", &position)) {
+            if(chain->count == MAX_POINT_OPS) {
+                fprintf(stderr, "parsePointOps: More than %d operations\n", MAX_POINT_OPS);
+                result = EXIT_FAILURE;
+                break;
+            }
+
+            char* arguments = strchr(token, '=');
+            if(arguments != NULL)
+                *arguments++ = '\0';
+            pointOp* op = &chain->ops[chain->count];
+            int type = -1;
+            for(int i = 0; i < (int)(sizeof(opFormats) / sizeof(opFormats[0])); i++) {
+                if(strcmp(token, opFormats[i].name) == 0)
+                    type = i;
+            }
+            if(type == -1) {
+                fprintf(stderr, "parsePointOps: Unknown operation %s\n", token);
+                result = EXIT_FAILURE;
+                break;
+            }
+            op->type = type;
+
+            // the curve is a name, not a number
+            if(type == OP_CURVE) {
+                transferCurve curve;
+                if(arguments == NULL || parseCurve(arguments, &curve) != EXIT_SUCCESS) {
+                    fprintf(stderr, "parsePointOps: Unknown curve %s\n", arguments != NULL ? arguments : "");
+                    result = EXIT_FAILURE;
+                    break;
+                }
+                op->values[0] = curve;
+                chain->count++;
+                continue;
+            }
+
+            // values are separated by colons
+            int valueCount = 0;
+            while(arguments != NULL && *arguments != '\0' && valueCount < 4) {
+                char* end;
+                op->values[valueCount++] = strtof(arguments, &end);
+                if(end == arguments || (*end != ':' && *end != '\0')) {
+                    valueCount = -1;
+                    break;
+                }
+                arguments = *end == ':' ? end + 1 : end;
+            }
+            if(valueCount < opFormats[type].minValues || valueCount > opFormats[type].maxValues
+                || (arguments != NULL && *arguments != '\0') || !checkPointOp(op, valueCount)) {
+                    fprintf(stderr, "parsePointOps: Invalid values for %s\n", token);
+                    result = EXIT_FAILURE;
+                    break;
+            }
+            chain->count++;
+    }
+
+    free(copy);
+    if(result == EXIT_SUCCESS && chain->count == firstCount) {
+        fprintf(stderr, "parsePointOps: No operations\n");
+        result = EXIT_FAILURE;
+    }
+    return result;
+}
+
+// Applies all operations of the chain to every entry of table (table[i] = chain(table[i]))
+// Gamma operations use the table of kernel, so "gamma=2.2" gives the same as --gamma 2.2
+// (the exact table if kernel is NULL or has no table)
+void applyPointOps(pointOpChain* chain, gammaKernel* kernel, uint8_t* table) {
+    uint8_t map[256];
+
+    for(int k = 0; k < chain->count; k++) {
+        pointOp* op = &chain->ops[k];
+        float* values = op->values;
+
+        for(int v = 0; v < 256; v++) {
+            switch(op->type) {
+                case OP_LEVELS:
+                    map[v] = toGray(values[2] + (v - values[0]) * (values[3] - values[2]) / (values[1] - values[0]));
+                    if(v <= values[0])
+                        map[v] = toGray(values[2]);
+                    else if(v >= values[1])
+                        map[v] = toGray(values[3]);
+                    break;
+                case OP_INVERT:
+                    map[v] = 255 - v;
+                    break;
+                case OP_THRESHOLD:
+                    map[v] = v >= values[0] ? 255 : 0;
+                    break;
+                case OP_BRIGHTNESS:
+                    map[v] = toGray(v + values[0]);
+                    break;
+                case OP_CONTRAST:
+                    map[v] = toGray((v - 127.5f) * values[0] + 127.5f);
+                    break;
+                case OP_CURVE:
+                    map[v] = toGray(255.0 * applyCurve((transferCurve)values[0], v / 255.0));
+                    break;
+                default:
+                    break;
+            }
+        }
+        if(op->type == OP_GAMMA && kernel != NULL && kernel->buildHash != NULL)
+            kernel->buildHash(map, values[0]);
+        else if(op->type == OP_GAMMA)
+            gamma_correct_build_table_exact(map, values[0]);
+
+        for(int i = 0; i < 256; i++)
+            table[i] = map[table[i]];
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef POINT_OPS_H
+#define POINT_OPS_H
+
+#include <stdint.h>
+#include "gamma_correct.h"
+
+// Most operations one --ops chain can have
+#define MAX_POINT_OPS 32
+
+// Operations on one gray value, all of them are folded into the 256 entry hash table
+typedef enum pointOpType {
+  OP_GAMMA,      // gamma=<g>: the table of the implementation for gamma g
+  OP_LEVELS,     // levels=<black>:<white>[:<output black>:<output white>]: stretch black - white to the output range
+  OP_INVERT,     // invert: 255 - v
+  OP_THRESHOLD,  // threshold=<t>: 255 if v >= t, else 0
+  OP_BRIGHTNESS, // brightness=<b>: v + b
+  OP_CONTRAST,   // contrast=<factor>: scale the distance to the middle gray 127.5
+  OP_CURVE       // curve=<name>: a standard transfer curve (transferCurve)
+} pointOpType;
+
+// Piecewise transfer curves of display standards, encode = linear light to signal, decode = back
+typedef enum transferCurve {
+  CURVE_LINEAR_TO_SRGB,    // IEC 61966-2-1 encode, also "srgb"
+  CURVE_SRGB_TO_LINEAR,    // IEC 61966-2-1 decode
+  CURVE_LINEAR_TO_REC709,  // ITU-R BT.709 OETF, also "rec709"
+  CURVE_REC709_TO_LINEAR,  // inverse BT.709 OETF
+  CURVE_LINEAR_TO_PQ,      // SMPTE ST 2084 inverse EOTF, 255 = 10000 cd/m2, also "pq"
+  CURVE_PQ_TO_LINEAR       // SMPTE ST 2084 EOTF
+} transferCurve;
+
+typedef struct pointOp {
+  pointOpType type;
+  float values[4];
+} pointOp;
+
+// Operations applied in order to the output of the gamma correction
+typedef struct pointOpChain {
+  int count;
+  pointOp ops[MAX_POINT_OPS];
+} pointOpChain;
+
+int parsePointOps(char* text, pointOpChain* chain);
+int appendPointOps(char* text, pointOpChain* chain);
+int parseCurve(char* name, transferCurve* curve);
+void applyPointOps(pointOpChain* chain, gammaKernel* kernel, uint8_t* table);
+
+#endif
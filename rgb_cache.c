@@ -0,0 +1,209 @@
+/*
+    This file includes the RGB table cache. For fixed coefficients and gamma the output of a plan
+    only depends on the RGB triple of a pixel, so all 2^24 outputs can be computed once and
+    every pixel becomes a single load (gamma_correct_rgb_table).
+    The table is built in parallel with the plan's own implementation (same results as without the table)
+    and saved to <cacheDirectory>/<implementation>_<a>_<b>_<c>_<gamma>_<table>.rgb (parameters as float bits,
+    table is a hash of the plan's hash table, so point operations get their own file).
+    Later runs with the same implementation and parameters only map that file.
+    Header file rgb_cache.h defines the file layout.
+*/
+
+#include "rgb_cache.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RGB_CACHE_FILE_BYTES (RGB_CACHE_HEADER_BYTES + (size_t)RGB_TABLE_ENTRIES)
+
+// Arguments of the table build, task "red" computes the 65536 entries of that red value
+typedef struct rgbBuildJob {
+  gammaPlan* plan;
+  uint8_t* table;
+  int failed;
+} rgbBuildJob;
+
+// Runs the plan on an image of all (red, green, blue) with this red value, the output is the table row
+static void buildRGBRow(void* args, int red) {
+    rgbBuildJob* job = args;
+    // a few bytes more, some implementations read up to 16 bytes at a time
+    uint8_t* pixels = malloc(256 * 256 * 3 + 16);
+    if(!pixels) {
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for(int green = 0; green < 256; green++) {
+        for(int blue = 0; blue < 256; blue++) {
+            uint8_t* pixel = pixels + (green * 256 + blue) * 3;
+            pixel[0] = red;
+            pixel[1] = green;
+            pixel[2] = blue;
+        }
+    }
+    executeGammaPlan(job->plan, pixels, 256, 256, job->table + ((size_t)red << 16));
+    free(pixels);
+}
+
+// Maps an existing cache file, fails if it is missing or was built for something else
+static int mapCacheFile(gammaPlan* plan, char* cacheName, rgbCacheHeader* header) {
+    struct stat fileStats;
+    int fd = open(cacheName, O_RDONLY);
+    if(fd == -1)
+        return EXIT_FAILURE;
+    if(fstat(fd, &fileStats) == -1 || (size_t)fileStats.st_size != RGB_CACHE_FILE_BYTES) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* mapping = mmap(NULL, RGB_CACHE_FILE_BYTES, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED)
+        return EXIT_FAILURE;
+    if(memcmp(mapping, header, sizeof(rgbCacheHeader)) != 0) {
+        munmap(mapping, RGB_CACHE_FILE_BYTES);
+        return EXIT_FAILURE;
+    }
+
+    plan->rgbMapping = mapping;
+    plan->rgbMappingSize = RGB_CACHE_FILE_BYTES;
+    plan->rgbTable = mapping + RGB_CACHE_HEADER_BYTES;
+    return EXIT_SUCCESS;
+}
+
+// Fills table with the plan's output of every RGB triple, on pool or on all cores if pool is NULL
+static int buildRGBTable(gammaPlan* plan, uint8_t* table, threadPool* pool) {
+    rgbBuildJob job = {.plan = plan, .table = table};
+    threadPool* ownPool = NULL;
+
+    if(pool == NULL)
+        pool = ownPool = createThreadPool(sysconf(_SC_NPROCESSORS_ONLN));
+    if(pool != NULL) {
+        runThreadPool(pool, buildRGBRow, &job, 256);
+    } else {
+        for(int red = 0; red < 256; red++)
+            buildRGBRow(&job, red);
+    }
+    freeThreadPool(ownPool);
+
+    if(job.failed) {
+        fprintf(stderr, "attachRGBTable: Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Gives the plan a table of all RGB triples, executeGammaPlan uses it from then on.
+// With a cacheDirectory the table is mapped from its cache file, or built and saved there;
+// without one (or if the file can not be written) it is built in memory only.
+int attachRGBTable(gammaPlan* plan, char* cacheDirectory, threadPool* pool) {
+    uint64_t traceStart = traceNow();
+    rgbCacheHeader header = {0};
+    char cacheName[4096];
+    char tempName[4096 + 32];
+    int fd = -1;
+    int saved = 0;
+
+    releaseRGBTable(plan);
+    memcpy(header.magic, RGB_CACHE_MAGIC, sizeof(RGB_CACHE_MAGIC));
+    strncpy(header.kernel, plan->kernel->name, sizeof(header.kernel) - 1);
+    header.a = plan->a;
+    header.b = plan->b;
+    header.c = plan->c;
+    header.gamma = plan->gamma;
+    if(plan->hasHash)
+        memcpy(header.hash, plan->hash, sizeof(header.hash));
+
+    if(cacheDirectory != NULL) {
+        uint32_t bits[4];
+        uint32_t tableHash = 2166136261u; // FNV-1a
+        memcpy(bits, &header.a, sizeof(bits));
+        for(int i = 0; i < 256; i++)
+            tableHash = (tableHash ^ header.hash[i]) * 16777619u;
+        snprintf(cacheName, sizeof(cacheName), "%s/%s_%08x_%08x_%08x_%08x_%08x.rgb", cacheDirectory,
+            plan->kernel->name, bits[0], bits[1], bits[2], bits[3], tableHash);
+        if(mapCacheFile(plan, cacheName, &header) == EXIT_SUCCESS) {
+            traceRecord("rgb table", traceStart);
+            return EXIT_SUCCESS;
+        }
+
+        // build into a temporary file, other processes only ever see complete tables
+        mkdir(cacheDirectory, 0755);
+        snprintf(tempName, sizeof(tempName), "%s.%d.tmp", cacheName, (int)getpid());
+        fd = open(tempName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd != -1 && ftruncate(fd, RGB_CACHE_FILE_BYTES) == -1) {
+            close(fd);
+            unlink(tempName);
+            fd = -1;
+        }
+        if(fd == -1)
+            fprintf(stderr, "attachRGBTable: Could not write %s, the table is not saved\n", cacheName);
+    }
+
+    uint8_t* mapping = MAP_FAILED;
+    if(fd != -1)
+        mapping = mmap(NULL, RGB_CACHE_FILE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mapping == MAP_FAILED) {
+        if(fd != -1) {
+            close(fd);
+            unlink(tempName);
+            fd = -1;
+        }
+        mapping = mmap(NULL, RGB_CACHE_FILE_BYTES, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapping == MAP_FAILED) {
+            fprintf(stderr, "attachRGBTable: Could not allocate table\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct timespec start;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if(buildRGBTable(plan, mapping + RGB_CACHE_HEADER_BYTES, pool) != EXIT_SUCCESS) {
+        munmap(mapping, RGB_CACHE_FILE_BYTES);
+        if(fd != -1) {
+            close(fd);
+            unlink(tempName);
+        }
+        return EXIT_FAILURE;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if(fd != -1) {
+        // the header goes in last and the file is on disk before it gets its name
+        memcpy(mapping, &header, sizeof(header));
+        if(msync(mapping, RGB_CACHE_FILE_BYTES, MS_SYNC) == -1 || rename(tempName, cacheName) == -1) {
+            fprintf(stderr, "attachRGBTable: Could not write %s, the table is not saved\n", cacheName);
+            unlink(tempName);
+        } else {
+            saved = 1;
+        }
+        close(fd);
+    }
+    mprotect(mapping, RGB_CACHE_FILE_BYTES, PROT_READ);
+
+    printf("Built RGB table for %s in %f seconds%s%s\n", plan->kernel->name,
+        end.tv_sec - start.tv_sec + 1e-9 * (end.tv_nsec - start.tv_nsec),
+        saved ? ", saved to " : "", saved ? cacheName : "");
+    plan->rgbMapping = mapping;
+    plan->rgbMappingSize = RGB_CACHE_FILE_BYTES;
+    plan->rgbTable = mapping + RGB_CACHE_HEADER_BYTES;
+    traceRecord("rgb table", traceStart);
+    return EXIT_SUCCESS;
+}
+
+// Unmaps the table of the plan, executeGammaPlan computes every pixel again
+void releaseRGBTable(gammaPlan* plan) {
+    if(plan->rgbMapping != NULL)
+        munmap(plan->rgbMapping, plan->rgbMappingSize);
+    plan->rgbTable = NULL;
+    plan->rgbMapping = NULL;
+    plan->rgbMappingSize = 0;
+}
@@ -0,0 +1,29 @@
+#ifndef RGB_CACHE_H
+#define RGB_CACHE_H
+
+#include <stdint.h>
+#include "plan.h"
+#include "parallel.h"
+
+// One output byte for every RGB triple
+#define RGB_TABLE_ENTRIES (1 << 24)
+// The table starts one page into the cache file, so it can be mapped page aligned
+#define RGB_CACHE_HEADER_BYTES 4096
+// Changes whenever the file layout changes, older files are rebuilt
+#define RGB_CACHE_MAGIC "GCRGB02"
+
+// Start of a cache file, identifies the implementation and parameters the table was built for
+typedef struct rgbCacheHeader {
+  char magic[8];
+  char kernel[64];
+  float a;
+  float b;
+  float c;
+  float gamma;
+  uint8_t hash[256]; // hash table of the plan (zeros without one), differs with --ops
+} rgbCacheHeader;
+
+int attachRGBTable(gammaPlan* plan, char* cacheDirectory, threadPool* pool);
+void releaseRGBTable(gammaPlan* plan);
+
+#endif
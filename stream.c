@@ -0,0 +1,261 @@
+/*
+    This file includes the streaming mode, which converts a PPM file to a PGM file in chunks of rows.
+    Only two chunks of input and output are in memory at a time, so the image can be larger than RAM.
+    Header file stream.h defines the chunk size.
+*/
+
+#include "stream.h"
+#include "image_library.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
+
+// State shared by the reader thread, the writer thread and the calling thread (compute)
+// Chunk k uses buffer slot k % 2, the semaphores hand the slots from one stage to the next.
+// In place a slot has one buffer for input and output, it is free for the reader once it is written.
+typedef struct streamJob {
+  int inputFd;
+  int outputFd;
+  off_t contentOffset; // first pixel in the input file
+  size_t width;
+  size_t height;
+  size_t chunkRows;
+  size_t chunkCount;
+  uint8_t* inputs[2];
+  uint8_t* outputs[2];
+  imageFile buffers[2][2]; // input and output buffer of every slot, padded for whole vectors
+  sem_t inputFree[2];
+  sem_t inputReady[2];
+  sem_t outputFree[2];
+  sem_t outputReady[2];
+  int inPlace;
+  int readError;
+  int writeError;
+} streamJob;
+
+// Number of rows in chunk k
+static size_t chunkRowCount(streamJob* job, size_t k) {
+    size_t rows = job->height - k * job->chunkRows;
+    return rows < job->chunkRows ? rows : job->chunkRows;
+}
+
+// Reads exactly size bytes at offset, returns EXIT_FAILURE on errors or a short file
+static int readFully(int fd, uint8_t* buffer, size_t size, off_t offset) {
+    while(size > 0) {
+        ssize_t bytesRead = pread(fd, buffer, size, offset);
+        if(bytesRead <= 0)
+            return EXIT_FAILURE;
+        buffer += bytesRead;
+        offset += bytesRead;
+        size -= bytesRead;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Writes exactly size bytes, returns EXIT_FAILURE on errors
+static int writeFully(int fd, uint8_t* buffer, size_t size) {
+    while(size > 0) {
+        ssize_t bytesWritten = write(fd, buffer, size);
+        if(bytesWritten <= 0)
+            return EXIT_FAILURE;
+        buffer += bytesWritten;
+        size -= bytesWritten;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Reader stage: reads chunk k + 1 while chunk k is computed
+static void* readerThread(void* args) {
+    streamJob* job = args;
+    off_t offset = job->contentOffset;
+
+    for(size_t k = 0; k < job->chunkCount; k++) {
+        int slot = k & 1;
+        size_t size = chunkRowCount(job, k) * job->width * 3;
+
+        sem_wait(&job->inputFree[slot]);
+        uint64_t start = traceNow();
+        if(!job->readError && readFully(job->inputFd, job->inputs[slot], size, offset))
+            job->readError = 1;
+        traceRecord("read", start);
+        // the chunk is not needed in the page cache anymore
+        posix_fadvise(job->inputFd, offset, size, POSIX_FADV_DONTNEED);
+        offset += size;
+        sem_post(&job->inputReady[slot]);
+    }
+    return NULL;
+}
+
+// Writer stage: appends chunk k - 1 to the output file while chunk k is computed
+static void* writerThread(void* args) {
+    streamJob* job = args;
+
+    for(size_t k = 0; k < job->chunkCount; k++) {
+        int slot = k & 1;
+        size_t size = chunkRowCount(job, k) * job->width;
+
+        sem_wait(&job->outputReady[slot]);
+        uint64_t start = traceNow();
+        if(!job->writeError && writeFully(job->outputFd, job->outputs[slot], size))
+            job->writeError = 1;
+        traceRecord("write", start);
+        sem_post(&job->outputFree[slot]);
+        if(job->inPlace)
+            sem_post(&job->inputFree[slot]);
+    }
+    return NULL;
+}
+
+// Opens the input, checks its header and size and writes the output header
+static int openStreamFiles(streamJob* job, char* inputName, char* outputName) {
+    struct stat fileStats;
+    imageFile header = {0};
+    uint8_t* headerBuffer = malloc(MAX_HEADER_BYTES);
+    if(!headerBuffer) {
+        fprintf(stderr, "gamma_correct_stream: Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+
+    job->inputFd = open(inputName, O_RDONLY);
+    if(job->inputFd == -1 || fstat(job->inputFd, &fileStats) == -1) {
+        fprintf(stderr, "gamma_correct_stream: Could not open input file\n");
+        free(headerBuffer);
+        return EXIT_FAILURE;
+    }
+    posix_fadvise(job->inputFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // parse the header from the first bytes of the file
+    ssize_t bytesRead = pread(job->inputFd, headerBuffer, MAX_HEADER_BYTES, 0);
+    headerReader reader = {.data = headerBuffer, .size = bytesRead > 0 ? bytesRead : 0};
+    size_t headerSize = 0;
+    int result = parsePPMHeader(&header, &reader, &headerSize);
+    free(headerBuffer);
+    if(result != EXIT_SUCCESS)
+        return EXIT_FAILURE;
+
+    job->width = header.width;
+    job->height = header.heigth;
+    job->contentOffset = headerSize;
+
+    size_t contentSize = job->width * job->height * 3;
+    if((size_t)fileStats.st_size - headerSize < contentSize) {
+        fprintf(stderr, "gamma_correct_stream: Content smaller than defined\n");
+        return EXIT_FAILURE;
+    }
+    if((size_t)fileStats.st_size - headerSize > contentSize) {
+        fprintf(stderr, "gamma_correct_stream: Content larger than defined\n");
+        return EXIT_FAILURE;
+    }
+
+    job->outputFd = open(outputName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(job->outputFd == -1) {
+        fprintf(stderr, "gamma_correct_stream: Could not open output file\n");
+        return EXIT_FAILURE;
+    }
+
+    char outputHeader[64];
+    int outputHeaderSize = snprintf(outputHeader, sizeof(outputHeader), "P5\n%zu %zu\n255\n",
+        job->width, job->height);
+    if(writeFully(job->outputFd, (uint8_t*)outputHeader, outputHeaderSize)) {
+        fprintf(stderr, "gamma_correct_stream: Could not write output file\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Converts inputName to outputName chunk by chunk with the given plan
+// Reading, computing and writing run at the same time on two buffer slots.
+// If pool is not NULL every chunk is computed with gamma_correct_parallel.
+// inPlace writes the output of a chunk over its input, which needs 25% less memory.
+int gamma_correct_stream(char* inputName, char* outputName, gammaPlan* plan, threadPool* pool,
+    int inPlace) {
+        streamJob job = {.inputFd = -1, .outputFd = -1, .inPlace = inPlace};
+        int result = EXIT_FAILURE;
+
+        if(openStreamFiles(&job, inputName, outputName) != EXIT_SUCCESS)
+            goto close;
+
+        job.chunkRows = CHUNK_BYTES / (job.width * 3 > 0 ? job.width * 3 : 1);
+        if(job.chunkRows < 1)
+            job.chunkRows = 1;
+        job.chunkCount = (job.height + job.chunkRows - 1) / job.chunkRows;
+
+        for(int slot = 0; slot < 2; slot++) {
+            if(allocImageContent(&job.buffers[slot][0], job.chunkRows * job.width * 3) != EXIT_SUCCESS
+                || (!inPlace && allocImageContent(&job.buffers[slot][1], job.chunkRows * job.width) != EXIT_SUCCESS))
+                goto freeBuffers;
+            job.inputs[slot] = job.buffers[slot][0].content;
+            job.outputs[slot] = inPlace ? job.inputs[slot] : job.buffers[slot][1].content;
+            sem_init(&job.inputFree[slot], 0, 1);
+            sem_init(&job.inputReady[slot], 0, 0);
+            sem_init(&job.outputFree[slot], 0, 1);
+            sem_init(&job.outputReady[slot], 0, 0);
+        }
+
+        pthread_t reader;
+        pthread_t writer;
+        pthread_create(&reader, NULL, readerThread, &job);
+        pthread_create(&writer, NULL, writerThread, &job);
+
+        for(size_t k = 0; k < job.chunkCount; k++) {
+            int slot = k & 1;
+            int rows = chunkRowCount(&job, k);
+
+            sem_wait(&job.inputReady[slot]);
+            sem_wait(&job.outputFree[slot]);
+
+            // every chunk starts at the start of its buffers, the rest of them is padding
+            uint64_t start = traceNow();
+            if(pool != NULL)
+                gamma_correct_parallel(pool, plan, job.inputs[slot], job.width, rows, job.outputs[slot], 1);
+            else
+                executeGammaPlanPadded(plan, job.inputs[slot], job.width * rows, job.outputs[slot]);
+            traceRecord("kernel", start);
+
+            // in place the writer frees the input once the output is written
+            if(!inPlace)
+                sem_post(&job.inputFree[slot]);
+            sem_post(&job.outputReady[slot]);
+        }
+
+        pthread_join(reader, NULL);
+        pthread_join(writer, NULL);
+
+        if(job.readError) {
+            fprintf(stderr, "gamma_correct_stream: Could not read input file\n");
+        } else if(job.writeError) {
+            fprintf(stderr, "gamma_correct_stream: Could not write output file\n");
+        } else {
+            printf("gamma_correct_stream: Converted %zu rows in %zu chunks of %zu rows\n",
+                job.height, job.chunkCount, job.chunkRows);
+            result = EXIT_SUCCESS;
+        }
+
+        for(int slot = 0; slot < 2; slot++) {
+            sem_destroy(&job.inputFree[slot]);
+            sem_destroy(&job.inputReady[slot]);
+            sem_destroy(&job.outputFree[slot]);
+            sem_destroy(&job.outputReady[slot]);
+        }
+
+    freeBuffers:
+        for(int slot = 0; slot < 2; slot++) {
+            freeImageFile(&job.buffers[slot][0]);
+            freeImageFile(&job.buffers[slot][1]);
+        }
+
+    close:
+        if(job.inputFd != -1)
+            close(job.inputFd);
+        if(job.outputFd != -1 && close(job.outputFd) == -1) {
+            fprintf(stderr, "gamma_correct_stream: Could not write output file\n");
+            result = EXIT_FAILURE;
+        }
+        return result;
+}
@@ -0,0 +1,18 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include "gamma_correct.h"
+#include "parallel.h"
+#include "plan.h"
+
+// Input bytes of one chunk, two chunks of input and output are held at a time
+// (in place only the two input chunks, the output is written over them)
+#define CHUNK_BYTES (4 * 1024 * 1024)
+// Longest PPM header (with comments) the streaming reader accepts
+#define MAX_HEADER_BYTES (64 * 1024)
+
+int gamma_correct_stream(char* inputName, char* outputName, gammaPlan* plan, threadPool* pool,
+    int inPlace);
+
+#endif
@@ -6,11 +6,21 @@
 #include "test.h"
 #include "image_library.h"
 #include "gamma_correct.h"
+#include "generate.h"
+#include "kernels.h"
+#include "plan.h"
+#include "rgb_cache.h"
+#include "parallel.h"
+#include "frames.h"
+#include "tiles.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
+#include <math.h>
 #include <immintrin.h>
+#include <stdio.h>
+#include <unistd.h>
 
 #define NTSC_A 0.3f
 #define NTSC_B 0.59f
@@ -24,6 +34,39 @@ int genericValidTestCase(int testCaseNumber, char *inputName,
         void (*function)
         (uint8_t*, int, int, float a, float, float, float, uint8_t*),
         int *tTests, int *sTests, int *fTests);
+int fixedPointTestCase(int testCaseNumber, float a, float b, float c,
+        int *tTests, int *sTests, int *fTests);
+int fastPowerTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests);
+int generatorTestCase(int testCaseNumber, imagePattern pattern,
+        int *tTests, int *sTests, int *fTests);
+int rgbTableTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests);
+int multiGammaTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests);
+int pointOpsTestCase(int testCaseNumber, char* ops, int (*expected)(int gammaValue),
+        int *tTests, int *sTests, int *fTests);
+int expectInverted(int gammaValue);
+int colorTableTestCase(int testCaseNumber, int *tTests, int *sTests, int *fTests);
+int curveTestCase(int testCaseNumber, char* curve, int middleValue,
+        int *tTests, int *sTests, int *fTests);
+int paddedImageTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests);
+int streamingTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests);
+int inPlaceTestCase(int testCaseNumber, size_t width, size_t height, int threads,
+        int *tTests, int *sTests, int *fTests);
+int colorInPlaceTestCase(int testCaseNumber, int threads,
+        int *tTests, int *sTests, int *fTests);
+int framesTestCase(int testCaseNumber, int threads,
+        int *tTests, int *sTests, int *fTests);
+int tilesTestCase(int testCaseNumber, size_t width, size_t height, int threads,
+        int *tTests, int *sTests, int *fTests);
+int blackTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests);
+int kernelTailTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests);
+int expectLevels(int gammaValue);
 
 void test() {
 
@@ -85,6 +128,112 @@ void test() {
     genericValidTestCase(8, "Inputs/Valid/input8_33x1.ppm", functionToUse,
         &totalTests, &successfulTests, &failedTests);
 
+    //FIXED POINT TEST CASES
+    fixedPointTestCase(1, NTSC_A, NTSC_B, NTSC_C,
+        &totalTests, &successfulTests, &failedTests);
+
+    fixedPointTestCase(2, 1.0f / 3, 1.0f / 3, 1.0f / 3,
+        &totalTests, &successfulTests, &failedTests);
+
+    //FAST POWER TEST CASES
+    fastPowerTestCase(1, 2.2f,
+        &totalTests, &successfulTests, &failedTests);
+
+    fastPowerTestCase(2, 10.0f,
+        &totalTests, &successfulTests, &failedTests);
+
+    fastPowerTestCase(3, 0.02f,
+        &totalTests, &successfulTests, &failedTests);
+
+    //GENERATOR TEST CASES
+    generatorTestCase(1, PATTERN_RANDOM,
+        &totalTests, &successfulTests, &failedTests);
+
+    generatorTestCase(2, PATTERN_PHOTO,
+        &totalTests, &successfulTests, &failedTests);
+
+    //RGB TABLE TEST CASES
+    rgbTableTestCase(1, KERNEL_C_HASH,
+        &totalTests, &successfulTests, &failedTests);
+
+    rgbTableTestCase(2, KERNEL_C_FASTPOW,
+        &totalTests, &successfulTests, &failedTests);
+
+    //MULTI GAMMA TEST CASES
+    multiGammaTestCase(1, KERNEL_C_HASH,
+        &totalTests, &successfulTests, &failedTests);
+
+    multiGammaTestCase(2, KERNEL_C_FASTPOW,
+        &totalTests, &successfulTests, &failedTests);
+
+    //POINT OPERATION TEST CASES
+    pointOpsTestCase(1, "invert", expectInverted,
+        &totalTests, &successfulTests, &failedTests);
+
+    pointOpsTestCase(2, "levels=0:255:255:0,brightness=0,contrast=1,invert,invert", expectInverted,
+        &totalTests, &successfulTests, &failedTests);
+
+    pointOpsTestCase(3, "levels=64:192,threshold=1", expectLevels,
+        &totalTests, &successfulTests, &failedTests);
+
+    //CURVE TEST CASES (value of 128 from the standard)
+    curveTestCase(1, "srgb", 188,
+        &totalTests, &successfulTests, &failedTests);
+
+    curveTestCase(2, "rec709-to-linear", 67,
+        &totalTests, &successfulTests, &failedTests);
+
+    //COLOR TEST CASES
+    colorTableTestCase(1, &totalTests, &successfulTests, &failedTests);
+
+    //PADDING TEST CASES
+    paddedImageTestCase(1, KERNEL_C_SSE,
+        &totalTests, &successfulTests, &failedTests);
+    paddedImageTestCase(2, KERNEL_ASM_HASH_SIMD16,
+        &totalTests, &successfulTests, &failedTests);
+
+    //STREAMING TEST CASES
+    streamingTestCase(1, KERNEL_ASM_HASH_SIMD,
+        &totalTests, &successfulTests, &failedTests);
+
+    //IN PLACE TEST CASES
+    inPlaceTestCase(1, 301, 97, 0,
+        &totalTests, &successfulTests, &failedTests);
+    inPlaceTestCase(2, 7, 3, 0,
+        &totalTests, &successfulTests, &failedTests);
+    inPlaceTestCase(3, 1024, 512, 4,
+        &totalTests, &successfulTests, &failedTests);
+    colorInPlaceTestCase(1, 0,
+        &totalTests, &successfulTests, &failedTests);
+    colorInPlaceTestCase(2, 4,
+        &totalTests, &successfulTests, &failedTests);
+
+    //FRAME STREAM TEST CASES
+    framesTestCase(1, 0,
+        &totalTests, &successfulTests, &failedTests);
+    framesTestCase(2, 3,
+        &totalTests, &successfulTests, &failedTests);
+
+    //INCREMENTAL TEST CASES
+    tilesTestCase(1, 301, 97, 0,
+        &totalTests, &successfulTests, &failedTests);
+    tilesTestCase(2, 1000, 333, 4,
+        &totalTests, &successfulTests, &failedTests);
+
+    //BLACK TEST CASES (every implementation, ln(0) and small gammas)
+    blackTestCase(1, 0.1f,
+        &totalTests, &successfulTests, &failedTests);
+    blackTestCase(2, 2.2f,
+        &totalTests, &successfulTests, &failedTests);
+    blackTestCase(3, 0.01f,
+        &totalTests, &successfulTests, &failedTests);
+
+    //KERNEL TAIL TEST CASES (odd widths, every implementation against its scalar version)
+    kernelTailTestCase(1, 2.2f,
+        &totalTests, &successfulTests, &failedTests);
+    kernelTailTestCase(2, 0.45f,
+        &totalTests, &successfulTests, &failedTests);
+
     printf("Ran %d tests\n", totalTests);
     printf("Successful tests: %d\n", successfulTests);
     printf("Failed tests: %d\n", failedTests);
@@ -129,3 +278,643 @@ int genericValidTestCase(int testCaseNumber, char *inputName,
     (*sTests)++;
     return 0;
 }
+
+// Checks every possible pixel: the fixed point key may only be 1 off the float key,
+// and only if the exact grayscale value is less than 255/2^14 (plus float rounding) from a whole number
+int fixedPointTestCase(int testCaseNumber, float a, float b, float c,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    int16_t weights[3];
+    convert_coeffs_to_fixed(a, b, c, weights);
+    for (int red = 0; red < 256; red++) {
+        for (int green = 0; green < 256; green++) {
+            for (int blue = 0; blue < 256; blue++) {
+                uint8_t floatKey = convert_pixel_to_grayscale(red, green, blue, a, b, c);
+                int fixedKey = (red * weights[0] + green * weights[1] + blue * weights[2]) >> FIXED_SHIFT;
+                double exact = (double)red * a + (double)green * b + (double)blue * c;
+                if (abs(fixedKey - floatKey) > 1
+                    || (fixedKey != floatKey && fabs(exact - round(exact)) >= 255.0 / 16384 + 1e-4)) {
+                    printf("fixedPointTestCase%d failed.\n", testCaseNumber);
+                    (*fTests)++;
+                    return 1;
+                }
+            }
+        }
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Checks x^gamma for x = k/65536: scalar and SSE must be equal and at most 5e-6 (about 80 ULP) off powf
+int fastPowerTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    for (int k = 0; k <= 65536; k++) {
+        float x = k / 65536.0f;
+        float exact = powf(x, gamma);
+        float fast = fast_power(x, gamma);
+        float fastSSE = _mm_cvtss_f32(fast_power_SSE(_mm_set1_ps(x), _mm_set1_ps(gamma)));
+        if (fast != fastSSE || fabsf(fast - exact) > 5e-6f * exact + 1e-30f) {
+            printf("fastPowerTestCase%d failed.\n", testCaseNumber);
+            (*fTests)++;
+            return 1;
+        }
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Generates a 301x97 image as a whole and in bands of 10 rows: both must be the same,
+// and a different seed must give a different image
+int generatorTestCase(int testCaseNumber, imagePattern pattern,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    imageFile whole = {0};
+    imageFile otherSeed = {0};
+    uint8_t* bands = malloc(width * height * 3);
+    int failed = bands == NULL
+        || generatePPMImage(&whole, width, height, pattern, 42) != 0
+        || generatePPMImage(&otherSeed, width, height, pattern, 43) != 0;
+
+    if (!failed) {
+        for (size_t y = 0; y < height; y += 10) {
+            generateRows(bands + y * width * 3, width, height, y, height - y < 10 ? height - y : 10, 
+                pattern, 42);
+        }
+        failed = memcmp(whole.content, bands, width * height * 3) != 0
+            || memcmp(whole.content, otherSeed.content, width * height * 3) == 0;
+    }
+
+    free(bands);
+    freeImageFile(&whole);
+    freeImageFile(&otherSeed);
+    if (failed) {
+        printf("generatorTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Converts a generated image with and without the RGB table (in memory only): both must be the same
+int rgbTableTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    imageFile input = {0};
+    gammaPlan plan;
+    uint8_t* computed = malloc(width * height);
+    uint8_t* lookedUp = malloc(width * height);
+    initGammaPlan(&plan, &kernelRegistry[implementation], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+    int failed = computed == NULL || lookedUp == NULL
+        || generatePPMImage(&input, width, height, PATTERN_PHOTO, 42) != 0;
+
+    if (!failed) {
+        executeGammaPlan(&plan, input.content, width, height, computed);
+        failed = attachRGBTable(&plan, NULL, NULL) != 0;
+    }
+    if (!failed) {
+        executeGammaPlan(&plan, input.content, width, height, lookedUp);
+        failed = memcmp(computed, lookedUp, width * height) != 0;
+    }
+
+    releaseRGBTable(&plan);
+    free(computed);
+    free(lookedUp);
+    freeImageFile(&input);
+    if (failed) {
+        printf("rgbTableTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Converts a generated image for 6 gammas in one pass: every output must be the same as with its own plan
+int multiGammaTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    float gammas[] = {0.45f, 1.0f, 1.8f, 2.2f, 2.4f, 10.0f};
+    int count = sizeof(gammas) / sizeof(gammas[0]);
+    imageFile input = {0};
+    gammaMultiPlan multiPlan;
+    uint8_t* outputs[MAX_GAMMAS];
+    uint8_t* single = malloc(width * height);
+    uint8_t* all = malloc(width * height * count);
+    initGammaMultiPlan(&multiPlan, &kernelRegistry[implementation], NTSC_A, NTSC_B, NTSC_C, gammas, count, NULL);
+    int failed = single == NULL || all == NULL
+        || generatePPMImage(&input, width, height, PATTERN_PHOTO, 42) != 0;
+
+    if (!failed) {
+        for (int k = 0; k < count; k++)
+            outputs[k] = all + k * width * height;
+        executeGammaMultiPlan(&multiPlan, input.content, width, height, outputs);
+        for (int k = 0; k < count && !failed; k++) {
+            executeGammaPlan(&multiPlan.plans[k], input.content, width, height, single);
+            failed = memcmp(single, outputs[k], width * height) != 0;
+        }
+    }
+
+    free(single);
+    free(all);
+    freeImageFile(&input);
+    if (failed) {
+        printf("multiGammaTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Gamma 2.2 followed by the operations: every table entry must be expected(entry of the gamma table)
+int pointOpsTestCase(int testCaseNumber, char* ops, int (*expected)(int gammaValue),
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    pointOpChain chain;
+    gammaPlan gammaOnly;
+    gammaPlan withOps;
+    int failed = parsePointOps(ops, &chain) != 0;
+
+    if (!failed) {
+        initGammaPlan(&gammaOnly, &kernelRegistry[KERNEL_C_HASH], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+        initGammaPlanWithOps(&withOps, &kernelRegistry[KERNEL_C_HASH], NTSC_A, NTSC_B, NTSC_C, 2.2f, &chain);
+        for (int i = 0; i < 256 && !failed; i++)
+            failed = withOps.hash[i] != expected(gammaOnly.hash[i]);
+    }
+    if (failed) {
+        printf("pointOpsTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+int expectInverted(int gammaValue) {
+    return 255 - gammaValue;
+}
+
+// levels=64:192 makes everything up to 64 black, threshold=1 everything else white
+int expectLevels(int gammaValue) {
+    return gammaValue <= 64 ? 0 : 255;
+}
+
+// Color mode with 3 different gammas on a generated image with leftover pixels:
+// the widest lookup this CPU supports must give the same as the scalar one, gamma 1 must keep green
+int colorTableTestCase(int testCaseNumber, int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    float gammas[] = {2.2f, 1.0f, 0.45f};
+    imageFile input = {0};
+    gammaColorPlan colorPlan;
+    uint8_t* scalar = malloc(width * height * 3);
+    uint8_t* widest = malloc(width * height * 3);
+    initGammaColorPlan(&colorPlan, gammas, NULL);
+    int failed = scalar == NULL || widest == NULL
+        || generatePPMImage(&input, width, height, PATTERN_RANDOM, 42) != 0;
+
+    if (!failed) {
+        gamma_correct_color_table(input.content, width, height, scalar, colorPlan.tables);
+        executeGammaColorPlan(&colorPlan, input.content, width, height, widest);
+        failed = memcmp(scalar, widest, width * height * 3) != 0;
+        for (size_t i = 1; i < width * height * 3 && !failed; i += 3)
+            failed = widest[i] != input.content[i];
+    }
+
+    free(scalar);
+    free(widest);
+    freeImageFile(&input);
+    if (failed) {
+        printf("colorTableTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// A curve without gamma: 0 and 255 stay, 128 becomes middleValue and the table never decreases
+int curveTestCase(int testCaseNumber, char* curve, int middleValue,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    pointOpChain chain = {0};
+    gammaPlan plan;
+    char op[64];
+    snprintf(op, sizeof(op), "curve=%s", curve);
+    int failed = appendPointOps(op, &chain) != 0;
+
+    if (!failed) {
+        initGammaPlanWithOps(&plan, &kernelRegistry[KERNEL_C_HASH], NTSC_A, NTSC_B, NTSC_C, NAN, &chain);
+        failed = plan.hash[0] != 0 || plan.hash[255] != 255 || plan.hash[128] != middleValue;
+        for (int i = 1; i < 256 && !failed; i++)
+            failed = plan.hash[i] < plan.hash[i - 1];
+    }
+    if (failed) {
+        printf("curveTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Converts a generated image with and without the scalar tail (executeGammaPlanPadded):
+// the output must be aligned and padded and the pixels the same
+int paddedImageTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    imageFile input = {0};
+    imageFile output = {0};
+    gammaPlan plan;
+    uint8_t* unpadded = malloc(width * height);
+    initGammaPlan(&plan, &kernelRegistry[implementation], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+    int failed = unpadded == NULL
+        || generatePPMImage(&input, width, height, PATTERN_PHOTO, 42) != 0
+        || allocImageContent(&output, width * height) != 0
+        || (uintptr_t)output.content % IMAGE_ALIGNMENT != 0
+        || input.padding < IMAGE_PADDING || output.padding < IMAGE_PADDING;
+
+    if (!failed) {
+        executeGammaPlan(&plan, input.content, width, height, unpadded);
+        executeGammaPlanPadded(&plan, input.content, width * height, output.content);
+        failed = memcmp(unpadded, output.content, width * height) != 0;
+    }
+
+    free(unpadded);
+    freeImageFile(&input);
+    freeImageFile(&output);
+    if (failed) {
+        printf("paddedImageTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Converts a generated image with the regular and the streaming version of an implementation,
+// the output starts 3 bytes after an aligned address so the streaming version has to align it first
+int streamingTestCase(int testCaseNumber, int implementation,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    imageFile input = {0};
+    gammaPlan plan;
+    uint8_t* regular = malloc(width * height);
+    uint8_t* streamed = malloc(width * height + 16);
+    initGammaPlan(&plan, &kernelRegistry[implementation], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+    int failed = regular == NULL || streamed == NULL
+        || generatePPMImage(&input, width, height, PATTERN_PHOTO, 42) != 0;
+
+    if (!failed) {
+        uint8_t* output = streamed + ((16 - (uintptr_t)streamed % 16) + 3) % 16;
+        plan.streaming = 0;
+        executeGammaPlan(&plan, input.content, width, height, regular);
+        plan.streaming = 1;
+        executeGammaPlan(&plan, input.content, width, height, output);
+        failed = !usesStreamingKernel(&plan, width * height) 
+            || memcmp(regular, output, width * height) != 0;
+    }
+
+    free(regular);
+    free(streamed);
+    freeImageFile(&input);
+    if (failed) {
+        printf("streamingTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Converts a generated image with every implementation the CPU supports (and every streaming version)
+// into a separate output and in place, on a pool of threads if threads > 0: both must be the same
+int inPlaceTestCase(int testCaseNumber, size_t width, size_t height, int threads,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    imageFile input = {0};
+    imageFile inPlace = {0};
+    uint8_t* separate = malloc(width * height);
+    threadPool* pool = threads > 0 ? createThreadPool(threads) : NULL;
+    int failed = separate == NULL || (threads > 0 && pool == NULL)
+        || generatePPMImage(&input, width, height, PATTERN_RANDOM, 42) != 0;
+
+    for (int k = 0; k < kernelCount && !failed; k++) {
+        if (!isKernelSupported(&kernelRegistry[k]))
+            continue;
+        for (int streaming = 0; streaming < 2 && !failed; streaming++) {
+            if (streaming && kernelRegistry[k].streamingHashFunction == NULL)
+                continue;
+            gammaPlan plan;
+            initGammaPlan(&plan, &kernelRegistry[k], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+            plan.streaming = streaming;
+            failed = generatePPMImage(&inPlace, width, height, PATTERN_RANDOM, 42) != 0;
+            if (failed)
+                break;
+            if (pool != NULL) {
+                gamma_correct_parallel(pool, &plan, input.content, width, height, separate, 0);
+                gamma_correct_parallel(pool, &plan, inPlace.content, width, height, inPlace.content, 0);
+            } else {
+                executeGammaPlan(&plan, input.content, width, height, separate);
+                executeGammaPlan(&plan, inPlace.content, width, height, inPlace.content);
+            }
+            failed = memcmp(separate, inPlace.content, width * height) != 0;
+            if (failed)
+                printf("inPlaceTestCase%d: %s%s differs in place.\n", testCaseNumber, 
+                    kernelRegistry[k].name, streaming ? " (streaming)" : "");
+            freeImageFile(&inPlace);
+        }
+    }
+
+    freeThreadPool(pool);
+    free(separate);
+    freeImageFile(&input);
+    if (failed) {
+        printf("inPlaceTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Two frames of different sizes (the second header with a comment) through a pipe,
+// the output has to be the two P5 images executeGammaPlan gives
+int framesTestCase(int testCaseNumber, int threads,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t widths[2] = {7, 64};
+    size_t heights[2] = {3, 40};
+    char* headerFormats[2] = {"P6\n%zu %zu\n255\n", "P6 # second frame\n%zu\n%zu 255\n"};
+    imageFile frames[2] = {0};
+    uint8_t expected[2][64 * 40];
+    gammaPlan plan;
+    initGammaPlan(&plan, &kernelRegistry[getDefaultKernel()], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+    threadPool* pool = threads > 0 ? createThreadPool(threads) : NULL;
+    FILE* output = tmpfile();
+    int pipeFds[2] = {-1, -1};
+    int failed = output == NULL || (threads > 0 && pool == NULL) || pipe(pipeFds) != 0;
+
+    // everything fits into the pipe buffer, so it is written before it is read
+    for (int k = 0; k < 2 && !failed; k++) {
+        char header[64];
+        int headerSize = snprintf(header, sizeof(header), headerFormats[k], widths[k], heights[k]);
+        size_t contentSize = widths[k] * heights[k] * 3;
+        failed = generatePPMImage(&frames[k], widths[k], heights[k], PATTERN_PHOTO, k + 1) != 0
+            || write(pipeFds[1], header, headerSize) != headerSize
+            || write(pipeFds[1], frames[k].content, contentSize) != (ssize_t)contentSize;
+        if (!failed)
+            executeGammaPlan(&plan, frames[k].content, widths[k], heights[k], expected[k]);
+    }
+    if (pipeFds[1] != -1)
+        close(pipeFds[1]);
+    if (!failed)
+        failed = gamma_correct_frames(pipeFds[0], fileno(output), &plan, pool, NULL) != 0;
+    if (pipeFds[0] != -1)
+        close(pipeFds[0]);
+
+    rewind(output);
+    for (int k = 0; k < 2 && !failed; k++) {
+        unsigned int width;
+        unsigned int height;
+        uint8_t content[64 * 40];
+        failed = fscanf(output, "P5\n%u %u\n255", &width, &height) != 2 || fgetc(output) != '\n'
+            || width != widths[k] || height != heights[k]
+            || fread(content, 1, width * height, output) != width * height
+            || memcmp(content, expected[k], width * height) != 0;
+    }
+
+    for (int k = 0; k < 2; k++)
+        freeImageFile(&frames[k]);
+    if (output != NULL)
+        fclose(output);
+    freeThreadPool(pool);
+    if (failed) {
+        printf("framesTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// --color --in-place with one gamma per channel gives the same output as a separate buffer
+int colorInPlaceTestCase(int testCaseNumber, int threads,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 301;
+    size_t height = 97;
+    float gammas[] = {1.8f, 2.2f, 3.0f};
+    imageFile input = {0};
+    imageFile inPlace = {0};
+    gammaColorPlan colorPlan;
+    uint8_t* separate = malloc(width * height * 3);
+    threadPool* pool = threads > 0 ? createThreadPool(threads) : NULL;
+    initGammaColorPlan(&colorPlan, gammas, NULL);
+    int failed = separate == NULL || (threads > 0 && pool == NULL)
+        || generatePPMImage(&input, width, height, PATTERN_RANDOM, 42) != 0
+        || generatePPMImage(&inPlace, width, height, PATTERN_RANDOM, 42) != 0;
+
+    if (!failed) {
+        if (pool != NULL) {
+            gamma_correct_parallel_color(pool, &colorPlan, input.content, width, height, separate);
+            gamma_correct_parallel_color(pool, &colorPlan, inPlace.content, width, height, inPlace.content);
+        } else {
+            executeGammaColorPlan(&colorPlan, input.content, width, height, separate);
+            executeGammaColorPlan(&colorPlan, inPlace.content, width, height, inPlace.content);
+        }
+        failed = memcmp(separate, inPlace.content, width * height * 3) != 0;
+    }
+
+    freeThreadPool(pool);
+    free(separate);
+    freeImageFile(&input);
+    freeImageFile(&inPlace);
+    if (failed) {
+        printf("colorInPlaceTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Three frames: a new one (all tiles dirty), one with a changed pixel (one dirty tile) and
+// the same again (no dirty tile). Every output has to be the full conversion.
+int tilesTestCase(int testCaseNumber, size_t width, size_t height, int threads,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    imageFile input = {0};
+    tileCache cache = {0};
+    uint8_t* expected = malloc(width * height);
+    uint8_t* output = malloc(width * height);
+    gammaPlan plan;
+    initGammaPlan(&plan, &kernelRegistry[getDefaultKernel()], NTSC_A, NTSC_B, NTSC_C, 2.2f);
+    threadPool* pool = threads > 0 ? createThreadPool(threads) : NULL;
+    int failed = expected == NULL || output == NULL || (threads > 0 && pool == NULL)
+        || generatePPMImage(&input, width, height, PATTERN_RANDOM, 42) != 0;
+
+    size_t expectedDirty[3] = {getTileCount(width, height), 1, 0};
+    for (int frame = 0; frame < 3 && !failed; frame++) {
+        if (frame == 1)
+            input.content[((height - 1) * width + width / 2) * 3] ^= 0x80;
+        size_t dirtyTiles;
+        executeGammaPlan(&plan, input.content, width, height, expected);
+        memset(output, 0, width * height);
+        failed = gamma_correct_tiles(&cache, &plan, pool, input.content, width, height, output, &dirtyTiles) != 0
+            || dirtyTiles != expectedDirty[frame] || memcmp(output, expected, width * height) != 0;
+        if (failed)
+            printf("tilesTestCase%d: frame %d differs (%zu dirty tiles).\n", testCaseNumber, frame, dirtyTiles);
+    }
+
+    freeTileCache(&cache);
+    freeThreadPool(pool);
+    free(expected);
+    free(output);
+    freeImageFile(&input);
+    if (failed) {
+        printf("tilesTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Black stays black with every implementation the CPU supports, also for small gammas
+// where gamma * ln(0) (or log2(0)) has to be below the clamp of e^x (or 2^x)
+int blackTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    size_t width = 37;
+    size_t height = 3;
+    uint8_t* input = calloc(width * height, 3);
+    uint8_t* output = malloc(width * height);
+    int failed = input == NULL || output == NULL;
+
+    for (int k = 0; k < kernelCount && !failed; k++) {
+        if (!isKernelSupported(&kernelRegistry[k]))
+            continue;
+        gammaPlan plan;
+        initGammaPlan(&plan, &kernelRegistry[k], NTSC_A, NTSC_B, NTSC_C, gamma);
+        memset(output, 0xFF, width * height);
+        executeGammaPlan(&plan, input, width, height, output);
+        for (size_t i = 0; i < width * height && !failed; i++) {
+            if (output[i] != 0) {
+                printf("blackTestCase%d: %s gives %d\n", testCaseNumber, kernelRegistry[k].name, output[i]);
+                failed = 1;
+            }
+        }
+    }
+
+    free(input);
+    free(output);
+    if (failed) {
+        printf("blackTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
+
+// Scalar implementation every implementation gives the same bytes as: the same keys or the same arithmetic
+// Only the C hash ones are the same as gamma_correct_c_hash, the asm keys truncate every product,
+// the fixed point keys can be 1 off and the asm implementations round instead of truncating.
+static const int tailReference[] = {
+    [KERNEL_ASM_HASH_SIMD] = KERNEL_ASM_HASH,
+    [KERNEL_C_HASH_SSE] = KERNEL_C_HASH,
+    [KERNEL_ASM_SIMD] = KERNEL_ASM,
+    [KERNEL_C_SSE] = KERNEL_C,
+    [KERNEL_ASM] = KERNEL_ASM,
+    [KERNEL_C] = KERNEL_C,
+    [KERNEL_ASM_HASH] = KERNEL_ASM_HASH,
+    [KERNEL_C_HASH] = KERNEL_C_HASH,
+    [KERNEL_C_NAIV] = KERNEL_C_NAIV,
+    [KERNEL_ASM_HASH_SIMD16] = KERNEL_ASM_HASH,
+    [KERNEL_C_HASH_AVX2] = KERNEL_ASM_HASH,
+    [KERNEL_C_HASH_AVX512] = KERNEL_ASM_HASH,
+    [KERNEL_C_HASH_FIXED] = KERNEL_C_HASH_FIXED,
+    [KERNEL_C_HASH_FIXED_SSE] = KERNEL_C_HASH_FIXED,
+    [KERNEL_C_HASH_FIXED_AVX2] = KERNEL_C_HASH_FIXED,
+    [KERNEL_C_FASTPOW] = KERNEL_C_FASTPOW,
+    [KERNEL_C_FASTPOW_SSE] = KERNEL_C_FASTPOW,
+    [KERNEL_C_FASTPOW_AVX2] = KERNEL_C_FASTPOW,
+};
+
+// Returns 1 if the implementations give different bytes for input
+static int kernelsDiffer(int first, int second, imageFile* input, float gamma, uint8_t* a, uint8_t* b) {
+    gammaPlan firstPlan;
+    gammaPlan secondPlan;
+    size_t pixels = (size_t)input->width * input->heigth;
+    initGammaPlan(&firstPlan, &kernelRegistry[first], NTSC_A, NTSC_B, NTSC_C, gamma);
+    initGammaPlan(&secondPlan, &kernelRegistry[second], NTSC_A, NTSC_B, NTSC_C, gamma);
+    memset(a, 0, pixels);
+    memset(b, 0xFF, pixels);
+    executeGammaPlan(&firstPlan, input->content, input->width, input->heigth, a);
+    executeGammaPlan(&secondPlan, input->content, input->width, input->heigth, b);
+    return memcmp(a, b, pixels) != 0;
+}
+
+// Odd widths run the tail of every vector loop: every implementation the CPU supports has to give
+// the same bytes as its scalar version, and all implementations of defaultOrder the same bytes
+int kernelTailTestCase(int testCaseNumber, float gamma,
+        int *tTests, int *sTests, int *fTests) {
+    (*tTests)++;
+    static const unsigned int widths[] = {1, 3, 5, 7, 15, 17, 31, 33, 63, 65, 127};
+    unsigned int height = 3;
+    uint8_t* a = malloc(127 * height);
+    uint8_t* b = malloc(127 * height);
+    int failed = a == NULL || b == NULL;
+    int last = defaultOrder[defaultOrderCount - 1];
+
+    for (unsigned int w = 0; w < sizeof(widths) / sizeof(widths[0]) && !failed; w++) {
+        imageFile input = {0};
+        if (generatePPMImage(&input, widths[w], height, PATTERN_RANDOM, 7 + w) != 0) {
+            failed = 1;
+            break;
+        }
+        for (int k = 0; k < kernelCount && !failed; k++) {
+            if (!isKernelSupported(&kernelRegistry[k]) || !isKernelSupported(&kernelRegistry[tailReference[k]]))
+                continue;
+            if (kernelsDiffer(k, tailReference[k], &input, gamma, a, b)) {
+                printf("kernelTailTestCase%d: %s differs from %s at width %u\n", testCaseNumber,
+                    kernelRegistry[k].name, kernelRegistry[tailReference[k]].name, widths[w]);
+                failed = 1;
+            }
+        }
+        for (int i = 0; i < defaultOrderCount && !failed; i++) {
+            if (!isKernelSupported(&kernelRegistry[defaultOrder[i]]) || !isKernelSupported(&kernelRegistry[last]))
+                continue;
+            if (kernelsDiffer(defaultOrder[i], last, &input, gamma, a, b)) {
+                printf("kernelTailTestCase%d: default %s differs from %s at width %u\n", testCaseNumber,
+                    kernelRegistry[defaultOrder[i]].name, kernelRegistry[last].name, widths[w]);
+                failed = 1;
+            }
+        }
+        freeImageFile(&input);
+    }
+
+    free(a);
+    free(b);
+    if (failed) {
+        printf("kernelTailTestCase%d failed.\n", testCaseNumber);
+        (*fTests)++;
+        return 1;
+    }
+    (*sTests)++;
+    return 0;
+}
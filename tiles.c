@@ -0,0 +1,157 @@
+/*
+    This file includes the incremental conversion of successive frames (--incremental).
+    The cache keeps the last input and its output. Every tile of TILE_WIDTH x TILE_HEIGHT pixels
+    of a new frame is compared with the last input (memcmp, which stops at the first difference),
+    only the tiles that differ run through the kernel, the others are copied from the last output.
+    The output is the same as a full conversion, a static scene costs a read and compare of the input
+    and a copy of the output. Header file tiles.h defines the cache.
+*/
+
+#include "tiles.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Arguments of one gamma_correct_tiles call, task "tileRow" works on one row of tiles
+typedef struct tileJob {
+  tileCache* cache;
+  gammaPlan* plan;
+  uint8_t* inputContent;
+  uint8_t* outputContent;
+  size_t tileColumns;
+  size_t dirtyTiles;
+} tileJob;
+
+// Number of tiles of an image, the last column and row can be smaller
+size_t getTileCount(unsigned int width, unsigned int height) {
+    return ((size_t)width + TILE_WIDTH - 1) / TILE_WIDTH * (((size_t)height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+}
+
+// Returns 1 if the tile at pixel (x, y) with columns x rows pixels differs from the last input
+static int tileDiffers(tileCache* cache, uint8_t* inputContent, size_t x, size_t y, size_t columns, size_t rows) {
+    for(size_t row = y; row < y + rows; row++) {
+        size_t offset = (row * cache->width + x) * 3;
+        if(memcmp(inputContent + offset, cache->input.content + offset, columns * 3) != 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Converts the pixels [offset, offset + pixels) and keeps input and output for the next frame
+static void convertRun(tileJob* job, size_t offset, size_t pixels) {
+    tileCache* cache = job->cache;
+    executeGammaPlanBand(job->plan, job->inputContent + offset * 3, pixels, job->outputContent + offset, pixels, 0);
+    memcpy(cache->input.content + offset * 3, job->inputContent + offset * 3, pixels * 3);
+    memcpy(cache->output.content + offset, job->outputContent + offset, pixels);
+}
+
+// Compares the tiles of row "tileRow", converts the dirty ones and copies the others
+static void correctTileRow(void* args, int tileRow) {
+    tileJob* job = args;
+    tileCache* cache = job->cache;
+    size_t width = cache->width;
+    size_t firstRow = (size_t)tileRow * TILE_HEIGHT;
+    size_t rows = cache->height - firstRow;
+    if(rows > TILE_HEIGHT)
+        rows = TILE_HEIGHT;
+    uint8_t* dirty = cache->dirty + (size_t)tileRow * job->tileColumns;
+
+    uint64_t start = traceNow();
+    size_t dirtyTiles = 0;
+    for(size_t column = 0; column < job->tileColumns; column++) {
+        size_t x = column * TILE_WIDTH;
+        size_t columns = width - x < TILE_WIDTH ? width - x : TILE_WIDTH;
+        dirty[column] = !cache->valid || tileDiffers(cache, job->inputContent, x, firstRow, columns, rows);
+        dirtyTiles += dirty[column];
+    }
+
+    if(dirtyTiles == job->tileColumns) {
+        // the whole row of tiles is one run of pixels
+        convertRun(job, firstRow * width, rows * width);
+    } else {
+        // runs of dirty or clean tiles in every row of pixels
+        for(size_t row = firstRow; row < firstRow + rows; row++) {
+            for(size_t column = 0; column < job->tileColumns; ) {
+                size_t end = column + 1;
+                while(end < job->tileColumns && dirty[end] == dirty[column])
+                    end++;
+                size_t x = column * TILE_WIDTH;
+                size_t pixels = (end * TILE_WIDTH < width ? end * TILE_WIDTH : width) - x;
+                size_t offset = row * width + x;
+                if(dirty[column])
+                    convertRun(job, offset, pixels);
+                else
+                    memcpy(job->outputContent + offset, cache->output.content + offset, pixels);
+                column = end;
+            }
+        }
+    }
+    __atomic_fetch_add(&job->dirtyTiles, dirtyTiles, __ATOMIC_RELAXED);
+    traceRecord("tiles", start);
+}
+
+// Makes the cache hold frames of width x height, a new size starts without a last frame
+static int resizeTileCache(tileCache* cache, unsigned int width, unsigned int height) {
+    if(cache->input.content != NULL && cache->width == width && cache->height == height)
+        return EXIT_SUCCESS;
+
+    freeImageFile(&cache->input);
+    freeImageFile(&cache->output);
+    free(cache->dirty);
+    cache->input = (imageFile){0};
+    cache->output = (imageFile){0};
+    cache->valid = 0;
+    cache->dirty = malloc(getTileCount(width, height));
+    if(!cache->dirty || allocImageContent(&cache->input, (size_t)width * height * 3) != EXIT_SUCCESS
+        || allocImageContent(&cache->output, (size_t)width * height) != EXIT_SUCCESS) {
+        fprintf(stderr, "gamma_correct_tiles: Malloc failed\n");
+        freeTileCache(cache);
+        return EXIT_FAILURE;
+    }
+    cache->width = width;
+    cache->height = height;
+    return EXIT_SUCCESS;
+}
+
+// Gamma correction of the next frame of a sequence, only the tiles that changed since the
+// last frame run through the plan, on pool if it is not NULL.
+// outputContent gets the whole frame, dirtyTiles the number of tiles that were recomputed.
+int gamma_correct_tiles(tileCache* cache, gammaPlan* plan, threadPool* pool,
+    uint8_t* inputContent, unsigned int width, unsigned int height, uint8_t* outputContent, size_t* dirtyTiles) {
+        *dirtyTiles = 0;
+        if(width == 0 || height == 0)
+            return EXIT_SUCCESS;
+        if(resizeTileCache(cache, width, height) != EXIT_SUCCESS)
+            return EXIT_FAILURE;
+
+        tileJob job = {
+            .cache = cache, .plan = plan, .inputContent = inputContent, .outputContent = outputContent,
+            .tileColumns = ((size_t)width + TILE_WIDTH - 1) / TILE_WIDTH
+        };
+        int tileRows = ((size_t)height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+        if(pool != NULL) {
+            runThreadPool(pool, correctTileRow, &job, tileRows);
+        } else {
+            for(int tileRow = 0; tileRow < tileRows; tileRow++)
+                correctTileRow(&job, tileRow);
+        }
+
+        cache->valid = 1;
+        cache->frames++;
+        cache->tiles += getTileCount(width, height);
+        cache->dirtyTiles += job.dirtyTiles;
+        *dirtyTiles = job.dirtyTiles;
+        return EXIT_SUCCESS;
+}
+
+// Frees the last frame, the totals stay
+void freeTileCache(tileCache* cache) {
+    freeImageFile(&cache->input);
+    freeImageFile(&cache->output);
+    free(cache->dirty);
+    cache->input = (imageFile){0};
+    cache->output = (imageFile){0};
+    cache->dirty = NULL;
+    cache->valid = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "gamma_correct.h"
+#include "image_library.h"
+#include "parallel.h"
+#include "plan.h"
+
+// Size of the tiles that are compared with the previous frame and recomputed if they changed
+#define TILE_WIDTH 64
+#define TILE_HEIGHT 16
+
+// Previous frame of an incremental conversion, every frame only recomputes the tiles that differ from it
+typedef struct tileCache {
+  imageFile input; // last input and its output, all tiles are dirty while valid is 0
+  imageFile output;
+  unsigned int width;
+  unsigned int height;
+  int valid;
+  uint8_t* dirty; // 1 for every tile of the current frame that is recomputed, tile row after tile row
+  size_t frames; // totals of all frames
+  size_t tiles;
+  size_t dirtyTiles;
+} tileCache;
+
+size_t getTileCount(unsigned int width, unsigned int height);
+int gamma_correct_tiles(tileCache* cache, gammaPlan* plan, threadPool* pool,
+    uint8_t* inputContent, unsigned int width, unsigned int height, uint8_t* outputContent, size_t* dirtyTiles);
+void freeTileCache(tileCache* cache);
+
+#endif
@@ -0,0 +1,110 @@
+/*
+    This file includes the stage timing of a run (open, parse, read, alloc, table, kernel, write, free).
+    Stages are recorded as spans, summed up in a table and exported as Chrome trace events,
+    which chrome://tracing or Perfetto can show per thread.
+    Header file trace.h defines the span struct.
+*/
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+static int enabled = 0;
+static struct timespec origin;
+static traceSpan spans[TRACE_MAX_SPANS];
+static int spanCount = 0; // can be larger than TRACE_MAX_SPANS, those spans were dropped
+
+// Starts recording, all times are relative to this call
+void traceEnable() {
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+    enabled = 1;
+}
+
+int traceEnabled() {
+    return enabled;
+}
+
+// Nanoseconds since traceEnable, 0 if tracing is off (so untraced runs skip the clock)
+uint64_t traceNow() {
+    if(!enabled)
+        return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - origin.tv_sec) * 1000000000ull + now.tv_nsec - origin.tv_nsec;
+}
+
+// Records the stage name from start (traceNow) until now, can be called from any thread
+void traceRecord(const char* name, uint64_t start) {
+    if(!enabled)
+        return;
+    uint64_t end = traceNow();
+    int index = __atomic_fetch_add(&spanCount, 1, __ATOMIC_RELAXED);
+    if(index >= TRACE_MAX_SPANS)
+        return;
+    spans[index].name = name;
+    spans[index].start = start;
+    spans[index].end = end;
+    spans[index].thread = syscall(SYS_gettid);
+}
+
+// Prints count, total and mean time and share of the wall time of every stage (in order of appearance)
+void printTraceSummary() {
+    if(!enabled)
+        return;
+    int count = spanCount < TRACE_MAX_SPANS ? spanCount : TRACE_MAX_SPANS;
+    double wall = traceNow() / 1e6;
+
+    printf("\n%-12s %8s %12s %12s %10s\n", "stage", "count", "total ms", "mean ms", "% of wall");
+    for(int i = 0; i < count; i++) {
+        // skip stages that were already printed
+        int first = 1;
+        for(int j = 0; j < i && first; j++)
+            first = strcmp(spans[j].name, spans[i].name) != 0;
+        if(!first)
+            continue;
+
+        int stageCount = 0;
+        double total = 0.0;
+        for(int j = i; j < count; j++) {
+            if(strcmp(spans[j].name, spans[i].name) == 0) {
+                stageCount++;
+                total += (spans[j].end - spans[j].start) / 1e6;
+            }
+        }
+        printf("%-12s %8d %12.3f %12.3f %9.1f%%\n", spans[i].name, stageCount, total,
+            total / stageCount, 100.0 * total / wall);
+    }
+    printf("%-12s %8s %12.3f\n", "wall", "", wall);
+    if(spanCount > TRACE_MAX_SPANS)
+        printf("(%d spans were dropped)\n", spanCount - TRACE_MAX_SPANS);
+    // stages of several threads can overlap, so the shares can add up to more than 100%
+}
+
+// Writes all spans as complete events ("ph": "X") in the Chrome trace event format
+int writeChromeTrace(char* traceName) {
+    FILE* file = fopen(traceName, "w");
+    if(!file) {
+        fprintf(stderr, "writeChromeTrace: Could not open %s\n", traceName);
+        return EXIT_FAILURE;
+    }
+
+    int count = spanCount < TRACE_MAX_SPANS ? spanCount : TRACE_MAX_SPANS;
+    int pid = getpid();
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for(int i = 0; i < count; i++) {
+        fprintf(file, "  {\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+            "\"pid\": %d, \"tid\": %d}%s\n", spans[i].name, spans[i].start / 1e3,
+            (spans[i].end - spans[i].start) / 1e3, pid, spans[i].thread, i + 1 < count ? "," : "");
+    }
+    fprintf(file, "]}\n");
+
+    if(fclose(file) != 0) {
+        fprintf(stderr, "writeChromeTrace: Could not write %s\n", traceName);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
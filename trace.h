@@ -0,0 +1,24 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Spans kept per run, later spans are dropped (and counted)
+#define TRACE_MAX_SPANS 65536
+
+// One timed stage: name, start and end in ns since traceEnable, thread that ran it
+typedef struct traceSpan {
+  const char* name;
+  uint64_t start;
+  uint64_t end;
+  int thread;
+} traceSpan;
+
+void traceEnable();
+int traceEnabled();
+uint64_t traceNow();
+void traceRecord(const char* name, uint64_t start);
+void printTraceSummary();
+int writeChromeTrace(char* traceName);
+
+#endif
@@ -0,0 +1,195 @@
+/*
+    This file includes the verification mode, which checks every implementation against a double
+    precision pow reference on the valid inputs and on generated images for a sweep of gammas and
+    coefficients. An implementation fails if its error is larger than the tolerance in its registry entry.
+    Hash implementations truncate the grayscale to a key, which near black at small gammas is far off
+    the exact result (gamma 0.1: grayscale 0.99 gives key 0, the exact result is 146). Their max error is
+    the distance to the results of the keys they may use (keyError around the exact grayscale), so it
+    only shows errors of the table itself. The mean error is always against the exact result.
+    Header file verify.h defines the result struct.
+*/
+
+#include "verify.h"
+#include "kernels.h"
+#include "plan.h"
+#include "generate.h"
+#include "image_library.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dirent.h>
+
+static const float verifyGammas[] = {0.1f, 0.45f, 1.0f, 2.2f, 4.0f};
+// NTSC, Rec. 709, equal and a single channel
+static const float verifyCoeffs[][3] = {
+    {0.3f, 0.59f, 0.11f}, {0.2126f, 0.7152f, 0.0722f}, {1.0f, 1.0f, 1.0f}, {0.0f, 1.0f, 0.0f}
+};
+// odd sizes, so every SIMD implementation also runs its scalar leftovers
+static const struct {
+  size_t width;
+  size_t height;
+  imagePattern pattern;
+} verifyImages[] = {
+    {61, 37, PATTERN_RANDOM}, {257, 129, PATTERN_RANDOM}, {255, 3, PATTERN_GRADIENT},
+    {199, 101, PATTERN_PHOTO}, {17, 1, PATTERN_FLAT}
+};
+
+#define COUNT(array) (int)(sizeof(array) / sizeof(array[0]))
+
+// Loads the generated images and all .ppm files of VERIFY_INPUT_DIRECTORY
+static int loadImages(imageFile** images, int* imageCount) {
+    int capacity = COUNT(verifyImages) + 64;
+    *images = calloc(capacity, sizeof(imageFile));
+    *imageCount = 0;
+    if(!*images) {
+        fprintf(stderr, "gamma_correct_verify: Malloc failed\n");
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 0; i < COUNT(verifyImages); i++) {
+        if(generatePPMImage(&(*images)[*imageCount], verifyImages[i].width, verifyImages[i].height,
+            verifyImages[i].pattern, i + 1) != EXIT_SUCCESS)
+                return EXIT_FAILURE;
+        (*imageCount)++;
+    }
+
+    DIR* directory = opendir(VERIFY_INPUT_DIRECTORY);
+    if(!directory)
+        return EXIT_SUCCESS;
+    struct dirent* entry;
+    char path[4096];
+    while((entry = readdir(directory)) != NULL && *imageCount < capacity) {
+        size_t length = strlen(entry->d_name);
+        if(length <= 4 || strcmp(entry->d_name + length - 4, ".ppm") != 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", VERIFY_INPUT_DIRECTORY, entry->d_name);
+        if(readPPMImage(&(*images)[*imageCount], path) == EXIT_SUCCESS)
+            (*imageCount)++;
+    }
+    closedir(directory);
+    return EXIT_SUCCESS;
+}
+
+// Exact result of every pixel: grayscale and pow in double precision, not truncated
+static void buildReference(imageFile* image, float a, float b, float c, float gamma, double* gray,
+    double* reference) {
+    size_t pixels = (size_t)image->width * image->heigth;
+    for(size_t i = 0; i < pixels; i++) {
+        uint8_t* pixel = image->content + i * 3;
+        gray[i] = pixel[0] * (double)a + pixel[1] * (double)b + pixel[2] * (double)c;
+        reference[i] = pow(gray[i] / 255.0, gamma) * 255.0;
+    }
+}
+
+// Exact result of key, clamped to the keys of the table
+static double keyResult(double key, float gamma) {
+    key = key < 0 ? 0 : key > 255 ? 255 : key;
+    return pow(key / 255.0, gamma) * 255.0;
+}
+
+// Adds the errors of output of kernel against reference to result
+static void compareOutput(gammaKernel* kernel, uint8_t* output, double* gray, double* reference,
+    float gamma, size_t pixels, verifyResult* result) {
+    for(size_t i = 0; i < pixels; i++) {
+        double error = fabs(output[i] - reference[i]);
+        double maxError = error;
+        if(kernel->buildHash != NULL) {
+            double low = keyResult(floor(gray[i]) - kernel->keyError, gamma);
+            double high = keyResult(ceil(gray[i]) + kernel->keyError, gamma);
+            maxError = output[i] < low ? low - output[i] : output[i] > high ? output[i] - high : 0;
+        }
+        if(maxError > result->maxError)
+            result->maxError = maxError;
+        result->sumError += error;
+        // the exact result truncated like every implementation does
+        int expected = reference[i] >= 255.0 ? 255 : (int)reference[i];
+        if(output[i] != expected)
+            result->mismatches++;
+    }
+    result->pixels += pixels;
+}
+
+// Runs one implementation (or all the CPU supports if implementation is -1) on all images,
+// gammas and coefficients and compares them to the reference.
+// Returns EXIT_FAILURE if an implementation is outside of its tolerance.
+int gamma_correct_verify(int implementation) {
+        imageFile* images = NULL;
+        int imageCount = 0;
+        double* reference = NULL;
+        double* gray = NULL;
+        uint8_t* output = NULL;
+        int result = EXIT_SUCCESS;
+        verifyResult results[kernelCount];
+        memset(results, 0, sizeof(results));
+
+        if(loadImages(&images, &imageCount) != EXIT_SUCCESS) {
+            result = EXIT_FAILURE;
+            goto freeBuffers;
+        }
+
+        size_t largest = 0;
+        for(int i = 0; i < imageCount; i++) {
+            size_t pixels = (size_t)images[i].width * images[i].heigth;
+            largest = pixels > largest ? pixels : largest;
+        }
+        reference = malloc(largest * sizeof(double) + 1);
+        gray = malloc(largest * sizeof(double) + 1);
+        output = malloc(largest + 1);
+        if(!reference || !gray || !output) {
+            fprintf(stderr, "gamma_correct_verify: Malloc failed\n");
+            result = EXIT_FAILURE;
+            goto freeBuffers;
+        }
+
+        for(int g = 0; g < COUNT(verifyGammas); g++) {
+            for(int k = 0; k < COUNT(verifyCoeffs); k++) {
+                // the coefficients are normalized like in main
+                float sum = verifyCoeffs[k][0] + verifyCoeffs[k][1] + verifyCoeffs[k][2];
+                float a = verifyCoeffs[k][0] / sum;
+                float b = verifyCoeffs[k][1] / sum;
+                float c = verifyCoeffs[k][2] / sum;
+
+                for(int i = 0; i < imageCount; i++) {
+                    size_t pixels = (size_t)images[i].width * images[i].heigth;
+                    buildReference(&images[i], a, b, c, verifyGammas[g], gray, reference);
+
+                    for(int v = 0; v < kernelCount; v++) {
+                        if((implementation != -1 && v != implementation) || !isKernelSupported(&kernelRegistry[v]))
+                            continue;
+                        gammaPlan plan;
+                        initGammaPlan(&plan, &kernelRegistry[v], a, b, c, verifyGammas[g]);
+                        executeGammaPlan(&plan, images[i].content, images[i].width, images[i].heigth, output);
+                        compareOutput(&kernelRegistry[v], output, gray, reference, verifyGammas[g], pixels,
+                            &results[v]);
+                    }
+                }
+            }
+        }
+
+        printf("%-36s %9s %9s %12s %9s %9s %s\n", "implementation", "max err", "mean err",
+            "mismatches", "max tol", "mean tol", "result");
+        for(int v = 0; v < kernelCount; v++) {
+            if(results[v].pixels == 0)
+                continue;
+            gammaKernel* kernel = &kernelRegistry[v];
+            double meanError = results[v].sumError / results[v].pixels;
+            int passed = results[v].maxError <= kernel->maxError && meanError <= kernel->meanError;
+            printf("%-36s %9.3f %9.4f %5.2f%% (%zu) %9.2f %9.3f %s\n", kernel->name,
+                results[v].maxError, meanError, 100.0 * results[v].mismatches / results[v].pixels,
+                results[v].mismatches, kernel->maxError, kernel->meanError, passed ? "PASS" : "FAIL");
+            if(!passed)
+                result = EXIT_FAILURE;
+        }
+        printf("Verified on %d images, %d gammas and %d coefficient sets\n", imageCount,
+            COUNT(verifyGammas), COUNT(verifyCoeffs));
+
+    freeBuffers:
+        free(reference);
+        free(gray);
+        free(output);
+        for(int i = 0; i < imageCount; i++)
+            freeImageFile(&images[i]);
+        free(images);
+        return result;
+}
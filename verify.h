@@ -0,0 +1,19 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stddef.h>
+
+// Directory whose .ppm files are verified next to the generated images
+#define VERIFY_INPUT_DIRECTORY "Inputs/Valid"
+
+// Error of one implementation over all images, gammas and coefficients
+typedef struct verifyResult {
+  double maxError; // largest |output - reference|
+  double sumError;
+  size_t pixels;
+  size_t mismatches; // outputs that are not the truncated reference
+} verifyResult;
+
+int gamma_correct_verify(int implementation);
+
+#endif